@@ -11,9 +11,15 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstdlib>
 
 #include "glm/glm.hpp"
 #include "SDL_helper.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "StarField.h"
+#include "ThreadPool.h"
 
 
 using glm::vec3;
@@ -24,49 +30,26 @@ using glm::vec3;
 const int SCREEN_WIDTH  = 640;
 const int SCREEN_HEIGHT = 480;
 
+// NOTE: Fewer stars than this per chunk aren't worth a thread, nor the layer it draws to.
+const int STARS_PER_CHUNK = 1 << 16;
+
+// One layer of pixels per chunk of stars, which are drawn on their own threads.
+std::vector<std::vector<Uint32>> star_layers;
+
 
 // --------------------------------------------------------
 // FUNCTION DECLARATIONS
 
-void UpdateStarField(std::vector<vec3>& stars, vec3 velocity, float dt);
-void DrawStarField(Window& window, const std::vector<vec3>& stars);
-void DrawRainbow(Window& window);
+int  StarChunks(const ThreadPool& pool, const StarField& stars);
+void UpdateStarField(ThreadPool& pool, StarField& stars, Kernel kernel, vec3 velocity, float dt);
+void DrawStarField(ThreadPool& pool, Window& window, const StarField& stars, Kernel kernel);
+void DrawRainbow(ThreadPool& pool, Window& window);
 vec3 Random();
 
 
 // --------------------------------------------------------
 // FUNCTION DEFINITIONS
 
-template <typename T>
-T lerp(const T& start, const T& stop, float t)
-{
-    // t is a value between 0 - 1
-    // t = 0 returns start
-    // t = 1 returns stop
-    // Otherwise, return in between
-    return start * (1.0f - t) + stop * t;
-}
-
-template <typename T>
-std::vector<T> Interpolate(const T& start, const T& stop, int samples)
-{
-    std::vector<T> result;
-    result.reserve(samples);
-
-    if (samples == 1) {
-        result.push_back(start);
-        return result;
-    }
-
-    auto dividend = float(samples);
-    for (int i = 0; i < samples; ++i) {
-        auto value = lerp(start, stop, float(i) / dividend);
-        result.push_back(value);
-    }
-
-    return result;
-}
-
 vec3 Random()
 {
     float x = 2.0f * (float(rand()) / float(RAND_MAX)) - 1.0f;
@@ -77,15 +60,46 @@ vec3 Random()
 
 int main(int argc, char* argv[])
 {
-    std::vector<vec3> stars(1000);
-    for (auto& star : stars)
-        star = Random();
+    // Usage: Lab1 [--frames N] [--width W] [--height H] [--out FILE] [--benchmark FILE] [--profile FILE]
+    //             [--stars N] [--threads N] [--kernel scalar|sse|avx2]
+    RenderOptions options = RenderOptions::Parse(argc, argv, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    int    star_count   = 1000;
+    int    thread_count = ThreadPool::DefaultThreadCount();
+    Kernel kernel       = BestKernel();
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag  = argv[i];
+        std::string value = argv[i + 1];
+        if      (flag == "--stars")   star_count   = std::atoi(value.c_str());
+        else if (flag == "--threads") thread_count = std::atoi(value.c_str());
+        else if (flag == "--kernel")  kernel       = value == "avx2" ? Kernel::AVX2 : value == "sse" ? Kernel::SSE : Kernel::SCALAR;
+    }
+    kernel = SupportedKernel(kernel);
 
-    Window window = Window::Create("Lab1", SCREEN_WIDTH, SCREEN_HEIGHT);
+    // NOTE: The stars are stored as structure of arrays, so the kernels can move and project 8 at a time.
+    StarField stars;
+    for (int i = 0; i < star_count; ++i)
+        stars.add(Random());
+
+    ThreadPool pool(thread_count);
+
+    Window window = Window::Create("Lab1", options);
     Clock  clock  = Clock();
 
+    // The benchmark flies through the starfield at a fixed speed, 60 frames per second.
+    Benchmark benchmark("Lab1", "stars");
+    benchmark.set("width",  window.width());
+    benchmark.set("height", window.height());
+    benchmark.set("threads", pool.size());
+    benchmark.set("kernel",  KernelName(kernel));
+
+    Profiler profiler;
+    profiler.trace(options.profiling());
+
     bool show_rainbow = true;
     bool is_running   = true;
+    int  frame        = 0;
     while (is_running)
     {
         SDL_Event event;
@@ -97,72 +111,141 @@ int main(int argc, char* argv[])
 
         float dt = clock.tick();
 
-        if (show_rainbow)
-        {
-            DrawRainbow(window);
-        }
-        else
-        {
-            UpdateStarField(stars, vec3(0, 0, 1), dt);
-            DrawStarField(window, stars);
-        }
+        profiler.begin_frame();
+        window.render([&]() {
+            {
+                Profiler::Scope scope = profiler.scope("draw");
+                if (options.benchmarking())
+                {
+                    benchmark.frame(double(stars.size()), [&]() {
+                        UpdateStarField(pool, stars, kernel, vec3(0, 0, 1), 1.0f / 60.0f);
+                        DrawStarField(pool, window, stars, kernel);
+                    });
+                }
+                else if (show_rainbow)
+                {
+                    DrawRainbow(pool, window);
+                }
+                else
+                {
+                    UpdateStarField(pool, stars, kernel, vec3(0, 0, 1), dt);
+                    DrawStarField(pool, window, stars, kernel);
+                }
+            }
+
+            // NOTE: The pixels are not shown on the screen
+            // until we update the window with this method.
+            {
+                Profiler::Scope scope = profiler.scope("present");
+                window.update();
+            }
+        });
+        profiler.end_frame();
+
+        if (options.headless() && ++frame == options.frames)
+            is_running = false;
+    }
+
+    if (options.benchmarking())
+    {
+        std::cout << benchmark.json();
+        Assert(benchmark.save(options.benchmark), "Couldn't write %s", options.benchmark.c_str());
+    }
 
-        // NOTE: The pixels are not shown on the screen
-        // until we update the window with this method.
-        window.update();
+    if (options.profiling())
+    {
+        std::cout << profiler.report();
+        Assert(profiler.save_trace(options.profile), "Couldn't write %s", options.profile.c_str());
     }
 
-    window.screenshot();
+    if (!options.out.empty())
+        window.save(options.out);
+    else if (!window.is_headless())
+        window.screenshot();
 
     Window::Destroy(&window);
     return 0;
 }
 
-void UpdateStarField(std::vector<vec3>& stars, vec3 velocity, float dt)
+/// How many chunks the stars are split into, to move and draw them on different threads.
+int StarChunks(const ThreadPool& pool, const StarField& stars)
 {
-    for (auto& star : stars)
-    {
-        star = star - (velocity * dt);
+    return std::max(1, std::min(pool.size(), stars.size() / STARS_PER_CHUNK));
+}
 
-        if (star.z <= 0)
-            star.z += 1;
-        if (star.z > 1)
-            star.z -= 1;
-    }
+/// The stars `[begin, end)` of chunk `chunk`.
+void ChunkRange(const StarField& stars, int chunks, int chunk, int& begin, int& end)
+{
+    begin = int(int64_t(stars.size()) * chunk       / chunks);
+    end   = int(int64_t(stars.size()) * (chunk + 1) / chunks);
 }
 
-void DrawStarField(Window& window, const std::vector<vec3>& stars)
+void UpdateStarField(ThreadPool& pool, StarField& stars, Kernel kernel, vec3 velocity, float dt)
 {
-    window.fill(BLACK);
+    int chunks = StarChunks(pool, stars);
+    pool.parallel_for(chunks, [&](int chunk) {
+        int begin, end;
+        ChunkRange(stars, chunks, chunk, begin, end);
+        stars.update(begin, end, velocity, dt, kernel);
+    });
+}
 
-    float f = SCREEN_HEIGHT / 2.0f; //Given in the instructions
-    for (const auto& star : stars)
-    {
-        auto position = star;
+void DrawStarField(ThreadPool& pool, Window& window, const StarField& stars, Kernel kernel)
+{
+    Framebuffer framebuffer = window.framebuffer();
+
+    int width  = framebuffer.width;
+    int height = framebuffer.height;
+
+    float f = height / 2.0f; //Given in the instructions
 
-        auto u = int(f * position.x / position.z + SCREEN_WIDTH  / 2.0f);
-        auto v = int(f * position.y / position.z + SCREEN_HEIGHT / 2.0f);
+    int chunks = StarChunks(pool, stars);
+    if (chunks == 1)
+    {
+        framebuffer.fill(BLACK);
+        stars.draw(0, stars.size(), framebuffer.pixels, width, height, framebuffer.stride, f, kernel);
+        return;
+    }
 
-        if (0 <= u && u < SCREEN_WIDTH && 0 <= v && v < SCREEN_HEIGHT)
+    // NOTE: Each chunk draws to a layer of its own, where 0 marks pixels without a star. Taking
+    //       the last chunk's star at each pixel then gives the same image as drawing them in order.
+    star_layers.resize(size_t(chunks));
+    pool.parallel_for(chunks, [&](int chunk) {
+        std::vector<Uint32>& layer = star_layers[chunk];
+        layer.assign(size_t(width) * size_t(height), 0);
+
+        int begin, end;
+        ChunkRange(stars, chunks, chunk, begin, end);
+        stars.draw(begin, end, layer.data(), width, height, width, f, kernel);
+    });
+
+    Uint32 background = ColorCode(BLACK);
+    pool.parallel_for(height, [&](int y) {
+        Uint32* row = framebuffer.row(y);
+        for (int x = 0; x < width; ++x)
         {
-            vec3 color = 0.2f * vec3(1, 1, 1) / (star.z * star.z);
-            window.set_pixel(u, v, glm::clamp(color, BLACK, WHITE));
+            Uint32 pixel = background;
+            for (const std::vector<Uint32>& layer : star_layers)
+            {
+                Uint32 star = layer[size_t(y) * size_t(width) + size_t(x)];
+                pixel = star != 0 ? star : pixel;
+            }
+            row[x] = pixel;
         }
-    }
+    });
 }
 
 
-void DrawRainbow(Window& window)
+void DrawRainbow(ThreadPool& pool, Window& window)
 {
-    auto left  = Interpolate(RED,  GREEN,  SCREEN_HEIGHT);
-    auto right = Interpolate(BLUE, YELLOW, SCREEN_HEIGHT);
+    Framebuffer framebuffer = window.framebuffer();
 
-    for (int y = 0; y < SCREEN_HEIGHT; ++y)
-    {
-        auto colors = Interpolate(left[y], right[y], SCREEN_WIDTH);
-        for (int x = 0; x < SCREEN_WIDTH; ++x)
-        {
-            window.set_pixel(x, y, colors[x]);
-        }
-    }
+    int width  = framebuffer.width;
+    int height = framebuffer.height;
+
+    // NOTE: Each row is computed straight into the pixels, so nothing is allocated, and the rows are spread over the threads.
+    Gradient rainbow = { RED, BLUE, GREEN, YELLOW };
+    pool.parallel_for(height, [&](int y) {
+        GradientRow(rainbow, y, width, height, framebuffer.row(y));
+    });
 }
@@ -1,9 +1,16 @@
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstdlib>
 
 #include "glm/glm.hpp"
 #include "SDL_helper.h"
 #include "TestModel.h"
+#include "RayTracing.h"
+#include "ThreadPool.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "Log.h"
 
 
 using std::vector;
@@ -15,13 +22,6 @@ using glm::vec3;
 using glm::mat3;
 
 
-struct Intersection
-{
-    vec3  position;
-    float distance;
-    int   triangle_index;
-};
-
 struct Camera {
     vec3  position;
     vec3  velocity;
@@ -43,22 +43,17 @@ struct Camera {
 const int SCREEN_WIDTH = 100;
 const int SCREEN_HEIGHT = 100;
 
-vec3 light_position1 = vec3(0, -0.8, 0.8);
-vec3 light_position = light_position1 /glm::length(light_position1);
-
-vec3 light_color = 14.0f * vec3(1, 1, 1);
-
-vec3 indirectLight = 0.5f * vec3(1, 1, 1);
+const vec3 light_position1 = vec3(0, -0.8, 0.8);
 
 
 // --------------------------------------------------------
 // FUNCTION DECLARATIONS
 
 
-void Update(float dt, Camera& camera);
-void Draw(Window& window, const Camera& camera, const vector<Triangle>& triangles);
-bool ClosestIntersection(vec3 start, vec3 direction, const vector<Triangle>& triangles, Intersection& closest_intersection);
-vec3 DirectLight(const Triangle& triangle, vector<Triangle> triangles, const Intersection& intersection);
+void Update(float dt, Camera& camera, Light& light, Log& logger);
+void ScriptedUpdate(int frame, int frames, Camera& camera, Light& light);
+void Orient(Camera& camera);
+void Draw(TileScheduler& scheduler, const Window& window, vector<vec3>& colors, const Camera& camera, const Scene& scene, const Light& light, TraceMode mode);
 
 
 // --------------------------------------------------------
@@ -97,11 +92,31 @@ mat3 rotation(float pitch, float yaw, float roll) {
 
 int main(int argc, char* argv[])
 {
-    auto  W = float(SCREEN_WIDTH);
-    auto  H = float(SCREEN_HEIGHT);
+    // Usage: Lab2 [--frames N] [--width W] [--height H] [--out FILE] [--benchmark FILE] [--profile FILE]
+    //             [--threads N] [--tile SIZE] [--kernel scalar|sse|avx2] [--trace single|packet]
+    RenderOptions options = RenderOptions::Parse(argc, argv, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    auto  H = float(options.height);
     float F = H / 2.0f;
 
-    Window window = Window::Create("Lab1", SCREEN_WIDTH, SCREEN_HEIGHT);
+    int       thread_count = ThreadPool::DefaultThreadCount();
+    int       tile_size    = 16;
+    Kernel    kernel       = BestKernel();
+    TraceMode trace_mode   = TraceMode::PACKET;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag  = argv[i];
+        std::string value = argv[i + 1];
+        if      (flag == "--threads") thread_count = std::atoi(value.c_str());
+        else if (flag == "--tile")    tile_size    = std::atoi(value.c_str());
+        else if (flag == "--kernel")  kernel       = value == "avx2" ? Kernel::AVX2 : value == "sse" ? Kernel::SSE : Kernel::SCALAR;
+        else if (flag == "--trace")   trace_mode   = value == "single" ? TraceMode::SINGLE : TraceMode::PACKET;
+    }
+
+    // NOTE: The threads are created once here and reused for every frame.
+    TileScheduler scheduler(thread_count, tile_size);
+
+    Window window = Window::Create("Lab2", options);
     Clock  clock = Clock();
     Camera camera = Camera{
         vec3(0.0f, 0.0f, 2.0f),  // position
@@ -112,9 +127,50 @@ int main(int argc, char* argv[])
         -F, 0.0f, 0.0f, 0.0f     // focal_length, yaw, pitch, roll
     };
 
-    vector<Triangle> triangles = LoadTestModel();
+    // NOTE: The scene is never modified after this; the light is
+    // the only thing in the world that changes between frames.
+    const Scene scene = Scene::Create(LoadTestModel(), kernel);
+    std::cout << "Intersection kernel: " << KernelName(scene.kernel()) << std::endl;
+    std::cout << "Primary rays: " << (trace_mode == TraceMode::PACKET ? "2x2 packets" : "single") << std::endl;
+    Light light = Light{
+        light_position1 / glm::length(light_position1),  // position
+        14.0f * vec3(1, 1, 1),                            // color
+        0.5f * vec3(1, 1, 1)                              // indirect
+    };
+
+    // NOTE: Only primary rays are counted; there is at most one shadow ray per primary ray.
+    Benchmark benchmark("Lab2", "primary_rays");
+    benchmark.set("width",   window.width());
+    benchmark.set("height",  window.height());
+    benchmark.set("threads", thread_count);
+    benchmark.set("tile",    tile_size);
+    benchmark.set("kernel",  KernelName(scene.kernel()));
+    benchmark.set("trace",   trace_mode == TraceMode::PACKET ? "packet" : "single");
+
+    // NOTE: Traced into floats, which `present` converts to pixels in one pass.
+    vector<vec3> colors(size_t(window.width()) * size_t(window.height()));
+    Profiler profiler;
+    profiler.trace(options.profiling());
+
+    // NOTE: The render time is logged as a mean once a second, by the log's own thread.
+    Log      logger;
+    Periodic summary(1.0);
+
+    auto render = [&]() {
+        profiler.begin_frame();
+        {
+            Profiler::Scope scope = profiler.scope("shading");
+            Draw(scheduler, window, colors, camera, scene, light, trace_mode);
+        }
+        {
+            Profiler::Scope scope = profiler.scope("present");
+            window.present(colors.data());
+        }
+        profiler.end_frame();
+    };
 
     bool running = true;
+    int  frame   = 0;
     while (running)
     {
         SDL_Event event;
@@ -127,35 +183,59 @@ int main(int argc, char* argv[])
 
         }
 
-        float dt = clock.tick();
-        Update(dt, camera);
-        Draw(window, camera, triangles);
+        if (options.benchmarking())
+        {
+            ScriptedUpdate(frame, options.frames, camera, light);
+            benchmark.frame(double(window.width()) * window.height(), [&]() { window.render(render); });
+        }
+        else
+        {
+            float dt = clock.tick();
+            if (summary.tick(dt))
+                logger.write(LogLevel::INFO, "Render time: %.2f ms (mean of %d frames)", 1000 * summary.mean(), summary.frame_count());
+
+            Update(dt, camera, light, logger);
+            window.render(render);
+        }
+
+        if (options.headless() && ++frame == options.frames)
+            running = false;
+    }
+
+    logger.flush();
+    if (options.benchmarking())
+    {
+        std::cout << benchmark.json();
+        Assert(benchmark.save(options.benchmark), "Couldn't write %s", options.benchmark.c_str());
+    }
 
-        // NOTE: The pixels are not shown on the screen 
-        // until we update the window with this method.
-        window.update();
+    if (options.profiling())
+    {
+        std::cout << profiler.report();
+        Assert(profiler.save_trace(options.profile), "Couldn't write %s", options.profile.c_str());
     }
 
-    window.screenshot();
+    if (!options.out.empty())
+        window.save(options.out);
+    else if (!window.is_headless())
+        window.screenshot();
 
     Window::Destroy(&window);
     return 0;
 }
 
-void Update(float dt, Camera& camera)
+void Update(float dt, Camera& camera, Light& light, Log& logger)
 {
-    std::cout << "Render time: " << dt << " s." << std::endl;
-
     const Uint8* key_state = SDL_GetKeyboardState(nullptr);
 
-    if (key_state[SDL_SCANCODE_UP]) { light_position.z -= 1.0f * dt; }
-    if (key_state[SDL_SCANCODE_DOWN]) { light_position.z += 1.0f * dt; }
-    if (key_state[SDL_SCANCODE_LEFT]) { light_position.x -= 1.0f * dt; }
-    if (key_state[SDL_SCANCODE_RIGHT]) { light_position.x += 1.0f * dt; }
-    if (key_state[SDL_SCANCODE_Z]) { light_position.y -= 1.0f * dt; }
-    if (key_state[SDL_SCANCODE_C]) { light_position.y += 1.0f * dt; }
-    if (key_state[SDL_SCANCODE_RSHIFT]) { std::cout << "Pressing RSHIFT" << std::endl; }
-    if (key_state[SDL_SCANCODE_RCTRL]) { std::cout << "Pressing RCTRL" << std::endl; }
+    if (key_state[SDL_SCANCODE_UP]) { light.position.z -= 1.0f * dt; }
+    if (key_state[SDL_SCANCODE_DOWN]) { light.position.z += 1.0f * dt; }
+    if (key_state[SDL_SCANCODE_LEFT]) { light.position.x -= 1.0f * dt; }
+    if (key_state[SDL_SCANCODE_RIGHT]) { light.position.x += 1.0f * dt; }
+    if (key_state[SDL_SCANCODE_Z]) { light.position.y -= 1.0f * dt; }
+    if (key_state[SDL_SCANCODE_C]) { light.position.y += 1.0f * dt; }
+    if (key_state[SDL_SCANCODE_RSHIFT]) { logger.write(LogLevel::DEBUG, "Pressing RSHIFT"); }
+    if (key_state[SDL_SCANCODE_RCTRL]) { logger.write(LogLevel::DEBUG, "Pressing RCTRL"); }
     if (key_state[SDL_SCANCODE_W]) { camera.position.z -= 1.0f * dt; }
     if (key_state[SDL_SCANCODE_S]) { camera.position.z += 1.0f * dt; }
     if (key_state[SDL_SCANCODE_D]) { camera.position.x += 1.0f * dt; }
@@ -163,6 +243,24 @@ void Update(float dt, Camera& camera)
     if (key_state[SDL_SCANCODE_E]) { camera.yaw += float(M_PI / 4.0) * dt; }
     if (key_state[SDL_SCANCODE_Q]) { camera.yaw -= float(M_PI / 4.0) * dt; }
 
+    Orient(camera);
+}
+
+/// Moves the camera and the light along a fixed loop, so every benchmark run renders the same frames.
+void ScriptedUpdate(int frame, int frames, Camera& camera, Light& light)
+{
+    float angle = 2.0f * float(M_PI) * float(frame) / float(frames);
+
+    camera.position = vec3(0.3f * sin(angle), 0.0f, 2.0f);
+    camera.yaw      = float(M_PI / 8.0) * sin(angle);
+    light.position  = vec3(0.5f * cos(angle), -0.6f, 0.5f * sin(angle));
+
+    Orient(camera);
+}
+
+/// Updates the camera's axes from its yaw, pitch and roll.
+void Orient(Camera& camera)
+{
     auto r = rotation(camera.pitch, camera.yaw, camera.roll);
     camera.right = vec3(r[0][0], r[0][1], r[0][2]);
     camera.up = vec3(r[1][0], r[1][1], r[1][2]);
@@ -185,108 +283,15 @@ void Update(float dt, Camera& camera)
      * */
 }
 
-void Draw(Window& window, const Camera& camera, const vector<Triangle>& triangles)
+/// Traces the colors of the window's pixels into `colors`, tile by tile.
+void Draw(TileScheduler& scheduler, const Window& window, vector<vec3>& colors, const Camera& camera, const Scene& scene, const Light& light, TraceMode mode)
 {
-    auto W = float(SCREEN_WIDTH);
-    auto H = float(SCREEN_HEIGHT);
+    PrimaryRays rays = { camera.position, camera.right, camera.up, camera.forward, camera.focal_length, window.width(), window.height() };
 
-    Intersection closest_intersection = { };
-
-    for (int y = 0; y < SCREEN_HEIGHT; ++y)
+    // Every pixel only depends on the scene and the camera, so the tiles can be
+    // rendered in any order and the image is the same for any number of threads.
+    scheduler.for_each_tile(window.width(), window.height(), [&](int x_min, int y_min, int x_max, int y_max)
     {
-        for (int x = 0; x < SCREEN_WIDTH; ++x)
-        {
-            float u = 2.0f * (float(x) / W) - 1.0f;  // Normalized between [-1, 1]
-            float v = 2.0f * (float(y) / H) - 1.0f;  // Normalized between [-1, 1]
-
-            auto direction = camera.right * u * (W / 2.0f) + camera.up * v * (H / 2.0f) + camera.forward * camera.focal_length;
-            if (ClosestIntersection(camera.position, direction, triangles, closest_intersection))
-            {
-                auto triangle = triangles[closest_intersection.triangle_index];
-                //                window.set_pixel(x, y, triangle.color);
-                vec3 illumination = DirectLight(triangle, triangles, closest_intersection);
-                vec3 R = triangle.color * (illumination + indirectLight);
-                window.set_pixel(x, y, glm::clamp(R, BLACK, WHITE));
-            }
-            else
-            {
-                window.set_pixel(x, y, BLACK);
-            }
-        }
-    }
-}
-
-bool ClosestIntersection(vec3 start, vec3 direction, const vector<Triangle>& triangles, Intersection& closest_intersection)
-{
-    float min_distance = std::numeric_limits<float>::max();
-    vec3  s = start;
-    vec3  d = direction;
-
-    for (int i = 0; i < triangles.size(); ++i)
-    {
-        Triangle triangle = triangles[i];
-        vec3 v0 = triangle.v0;
-        vec3 v1 = triangle.v1;
-        vec3 v2 = triangle.v2;
-        vec3 e1 = v1 - v0;
-        vec3 e2 = v2 - v0;
-        vec3 b = s - v0;
-        mat3 A(-d, e1, e2);
-        vec3 x = glm::inverse(A) * b;
-
-        // We know from the instructions that x = (t, u, v) where 0 <= t, 0 < u, 0 < v, u + v < 1
-        // We name t tray instead since we already have a global variable t for time
-        // To get the intersection we create an if-statement
-
-        float t_ray = x[0];
-        float u = x[1];
-        float v = x[2];
-
-        if (t_ray >= 0 && u >= 0 && v >= 0 && u + v <= 1)
-        {
-            vec3 pos = start + direction * t_ray;
-            if (t_ray < min_distance)
-            {
-                min_distance = t_ray;
-                closest_intersection.position = pos;
-                closest_intersection.distance = t_ray;
-                closest_intersection.triangle_index = i;
-            }
-        }
-    }
-
-    if (min_distance < std::numeric_limits<float>::max())
-        return true;
-    else
-        return false;
-}
-
-
-vec3 DirectLight(const Triangle& triangle, vector<Triangle> triangles, const Intersection& intersection) {
-    vec3  rh = light_position - intersection.position;
-    float r = glm::length(rh);
-    vec3  n = glm::normalize(triangle.normal);
-    float A = float(4.0 * M_PI) * r * r;
-    vec3  P = light_color;
-    vec3  B = P / A;
-    //vec3 phi = vec3(0.4, 0.4, 0);
-    vec3 D = B * glm::max(glm::dot(rh, n), 0.0f);
-
-    Intersection shadow;
-
-    if (ClosestIntersection(light_position, -rh / r, triangles, shadow)) {
-        /*std::cout << r;
-        std::cout << "hej";
-        std::cout << shadow.distance;*/
-        // These values are very close and the if statement gets true too often so if we add values to the shadow distance side we get better results somehow
-        if (shadow.distance + 0.000001 < r) {
-            //std::cout << "hej";
-            return vec3(0);
-        }
-
-    }
-
-    vec3 R = triangle.color * D;
-
-    return R;
+        ShadeTile(scene, light, rays, mode, x_min, y_min, x_max, y_max, colors.data());
+    });
 }
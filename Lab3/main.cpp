@@ -1,15 +1,23 @@
 #include <iostream>
 #include <vector>
-#include <tuple>
 
 #include "glm/glm.hpp"
 #include "SDL_helper.h"
 #include "TestModel.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "GBuffer.h"
+#include "Interpolation.h"
+#include "Arena.h"
+#include "Scanline.h"
 #include <algorithm>
+#include <string>
+#include <cstdlib>
 
 
 using std::vector;
-using std::tuple;
 
 using glm::vec2;
 using glm::vec3;
@@ -33,11 +41,21 @@ struct Vertex {
 };
 
 
-struct Pixel {
-    int x;
-    int y;
-    float z_inv;
-    vec3  position;
+/// How the triangles are filled: row by row from the edges, with edge functions (see `RasterizeTriangle`),
+/// or with edge functions in screen tiles on all threads (see `DrawTiled`).
+enum class RasterMode
+{
+    SCANLINE,
+    EDGE,
+    TILED,
+};
+
+/// Whether fragments are lit as soon as they pass the depth test, or stored in a G-buffer
+/// and lit once per pixel after all triangles are drawn (see `LightingPass`).
+enum class ShadingMode
+{
+    FORWARD,
+    DEFERRED,
 };
 
 
@@ -57,24 +75,44 @@ struct Camera {
 
 };
 
-float depth_buffer[SCREEN_HEIGHT][SCREEN_WIDTH] = { 0 };
+// NOTE: All sized to the window in `main`. The colors are converted to
+// the window's pixels in one pass at the end of the frame.
+HierarchicalDepth depth_buffer;
+GBuffer           g_buffer;
+vector<vec3>      color_buffer;
+
+// NOTE: Everything `Draw` needs only until the end of the frame is allocated here,
+// and freed all at once when the next frame starts.
+Arena frame_arena;
 
 
+/// The screen triangles of one frame, after culling and clipping. Every triangle of the
+/// model has `MAX_CLIPPED_TRIANGLES` slots, so they can be filled in parallel: triangle
+/// `i` was clipped into `counts[i]` triangles, where triangle `k` of slot `i * MAX_CLIPPED_TRIANGLES + k`
+/// starts at `vertices[3 * (i * MAX_CLIPPED_TRIANGLES + k)]`.
+struct ClippedTriangles
+{
+    vector<ScreenVertex> vertices;
+    vector<int>          counts;
+};
+
 // --------------------------------------------------------
 // FUNCTION DECLARATIONS
 
 
-void Draw(Window& window, const Camera& camera, const vector<Triangle>& triangles);
+void Draw(Window& window, const Camera& camera, const vector<Triangle>& triangles, RasterMode mode, ShadingMode shading);
+void DrawTiled(ThreadPool& pool, TileBinner& binner, ClippedTriangles& clipped, Window& window, const Camera& camera, const vector<Triangle>& triangles, ShadingMode shading);
+void LightingPass(ThreadPool* pool, Window& window, const vector<Triangle>& triangles);
 void Update(Camera& camera, float dt);
+void ScriptedUpdate(Camera& camera, int frame, int frames);
 
-vector<Pixel> Interpolate(Pixel a, Pixel b);
-Pixel VertexShader(const Camera& camera, const Vertex& v);
-vector<Pixel> Rasterize(const vector<Pixel>& polygon);
+ClipVertex VertexShader(const Window& window, const Camera& camera, const Vertex& v);
+template <typename Emit>
+int ProcessTriangle(const Window& window, const Camera& camera, const Triangle& triangle, Emit&& emit);
+Pixel ToPixel(const Window& window, const ScreenVertex& v);
+void OutputFragment(Window& window, ShadingMode shading, const Pixel& pixel, int index, const Triangle& triangle);
 void PixelShader(Window& window, const Pixel& pixel, const Triangle& triangle);
-
-void DrawLine(Window& window, Pixel a, Pixel b, vec3 color);
-void DrawPolygonEdges(Window& window, const vector<vec3>& vertices);
-tuple<vector<Pixel>, vector<Pixel>> ComputePolygonRows(const vector<Pixel>& vertexPixels);
+vec3 Illuminate(const Triangle& triangle, float falloff);
 
 
 mat3 rotation_x(float theta) {
@@ -109,14 +147,74 @@ mat3 rotation(float pitch, float yaw, float roll) {
 
 int main(int argc, char* argv[])
 {
+	// Usage: Lab3 [--frames N] [--width W] [--height H] [--out FILE] [--benchmark FILE] [--profile FILE]
+	//             [--raster scanline|edge|tiled] [--shading forward|deferred] [--threads N]
+	RenderOptions options = RenderOptions::Parse(argc, argv, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+	RasterMode  raster_mode  = RasterMode::TILED;
+	ShadingMode shading      = ShadingMode::FORWARD;
+	int         thread_count = ThreadPool::DefaultThreadCount();
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string flag  = argv[i];
+		std::string value = argv[i + 1];
+		if      (flag == "--raster")  raster_mode  = value == "scanline" ? RasterMode::SCANLINE : value == "edge" ? RasterMode::EDGE : RasterMode::TILED;
+		else if (flag == "--shading") shading      = value == "deferred" ? ShadingMode::DEFERRED : ShadingMode::FORWARD;
+		else if (flag == "--threads") thread_count = std::atoi(value.c_str());
+	}
+
+	// NOTE: The threads, bins and clipped triangles are created once here and reused for every frame.
+	ThreadPool       pool(thread_count);
+	TileBinner       binner(64);
+	ClippedTriangles clipped;
+
 	vector<Triangle> triangles = LoadTestModel();
-	Window window = Window::Create("Lab3", SCREEN_WIDTH, SCREEN_HEIGHT);
+	Window window = Window::Create("Lab3", options);
 	Clock  clock  = Clock();
 
+	depth_buffer.resize(0, 0, window.width(), window.height());
+	g_buffer.resize(window.width(), window.height());
+	color_buffer.resize(size_t(window.width()) * size_t(window.height()));
+
     Camera camera = { };
 	camera.position = vec3(0.0, 0.0, 3.001);
 
+	Benchmark benchmark("Lab3", "triangles");
+	benchmark.set("width",  window.width());
+	benchmark.set("height", window.height());
+	benchmark.set("raster",  raster_mode == RasterMode::TILED ? "tiled" : raster_mode == RasterMode::EDGE ? "edge" : "scanline");
+	benchmark.set("shading", shading == ShadingMode::DEFERRED ? "deferred" : "forward");
+	benchmark.set("threads", pool.size());
+
+	Profiler profiler;
+	profiler.trace(options.profiling());
+
+	auto draw = [&]() {
+		profiler.begin_frame();
+		{
+			Profiler::Scope scope = profiler.scope("geometry");
+			if (raster_mode == RasterMode::TILED)
+				DrawTiled(pool, binner, clipped, window, camera, triangles, shading);
+			else
+				Draw(window, camera, triangles, raster_mode, shading);
+		}
+
+		// NOTE: Only the tiled mode lights the rows on all threads, so the other modes stay single threaded.
+		if (shading == ShadingMode::DEFERRED)
+		{
+			Profiler::Scope scope = profiler.scope("lighting");
+			LightingPass(raster_mode == RasterMode::TILED ? &pool : nullptr, window, triangles);
+		}
+
+		{
+			Profiler::Scope scope = profiler.scope("present");
+			window.present(color_buffer.data());
+		}
+		profiler.end_frame();
+	};
+
 	bool running = true;
+	int  frame   = 0;
 	while (running)
 	{
 		float dt = clock.tick();
@@ -130,15 +228,37 @@ int main(int argc, char* argv[])
 			}
 		}
 
-		Update(camera, dt);
-		Draw(window, camera, triangles);
+		if (options.benchmarking())
+		{
+			ScriptedUpdate(camera, frame, options.frames);
+			benchmark.frame(double(triangles.size()), [&]() { window.render(draw); });
+		}
+		else
+		{
+			Update(camera, dt);
+			window.render(draw);
+		}
+
+		if (options.headless() && ++frame == options.frames)
+			running = false;
+	}
+
+	if (options.benchmarking())
+	{
+		std::cout << benchmark.json();
+		Assert(benchmark.save(options.benchmark), "Couldn't write %s", options.benchmark.c_str());
+	}
 
-		// NOTE: The pixels are not shown on the screen 
-		// until we update the window with this method.
-		window.update();
+	if (options.profiling())
+	{
+		std::cout << profiler.report();
+		Assert(profiler.save_trace(options.profile), "Couldn't write %s", options.profile.c_str());
 	}
 
-	window.screenshot();
+	if (!options.out.empty())
+		window.save(options.out);
+	else if (!window.is_headless())
+		window.screenshot();
 
 	Window::Destroy(&window);
 	return 0;
@@ -172,166 +292,210 @@ void Update(Camera& camera, float dt)
     camera.transform = rotation(camera.pitch, camera.yaw, camera.roll);
 }
 
-
-void Draw(Window& window, const Camera& camera, const vector<Triangle>& triangles)
+/// Moves the camera and the light along a fixed loop, so every benchmark run renders the same frames.
+void ScriptedUpdate(Camera& camera, int frame, int frames)
 {
-	window.fill(BLACK);
-
-    for (int y = 0; y < SCREEN_HEIGHT; ++y)
-        for (int x = 0; x < SCREEN_WIDTH; ++x)
-            depth_buffer[y][x] = 0;
-
-	for (const auto& triangle : triangles)
-	{
-		vector<Pixel> polygon = {
-		        VertexShader(camera, Vertex { triangle.v0 }),
-		        VertexShader(camera, Vertex { triangle.v1 }),
-		        VertexShader(camera, Vertex { triangle.v2 }),
-		};
+    float angle = 2.0f * float(M_PI) * float(frame) / float(frames);
 
-        vector<Pixel> pixels = Rasterize(polygon);
+    camera.position = vec3(0.3f * sin(angle), 0.0f, 3.001f);
+    camera.yaw      = float(M_PI / 16.0) * sin(angle);
+    light_position  = vec3(0.4f * cos(angle), -0.5f, -0.7f + 0.2f * sin(angle));
 
-        for (const Pixel& pixel : pixels)
-            PixelShader(window, pixel, triangle);
-	}
+    camera.transform = rotation(camera.pitch, camera.yaw, camera.roll);
 }
 
 
-/// Expects t to be a value between 0-1.
-float Interpolate(float a, float b, float t) {
-    return (1.0f - t) * a  +  t * b;
-}
-
-/// High precision loss of `a` and `b` differs much in exponents.
-float FastLerp(float a, float b, float t)
+void Draw(Window& window, const Camera& camera, const vector<Triangle>& triangles, RasterMode mode, ShadingMode shading)
 {
-    return a + t * (b - a);
-}
+    frame_arena.reset();
 
-//
-float FastLerp2(float a, float b, float t)
-{
-    return b - (b - a) * (1.0f - t);
-}
+    if (shading == ShadingMode::DEFERRED)
+        g_buffer.clear();
+    else
+        std::fill(color_buffer.begin(), color_buffer.end(), BLACK);
 
+    depth_buffer.clear();
 
-vector<Pixel> Interpolate(Pixel a, Pixel b)
-{
-    vec3 start(a.x, a.y, a.z_inv);
-    vec3 stop(b.x, b.y, b.z_inv);
-
-    auto delta = glm::abs(stop - start);
-    int pixels = int(glm::max(delta.x, delta.y)) + 1;
-    vector<Pixel> line(pixels);
-
-	auto step_a = vec3(stop - start) / float(glm::max(pixels - 1, 1));
-    auto step_b = vec3(b.position - a.position) / float(glm::max(pixels - 1, 1));
-	vec3 current_a(start);
-    vec3 current_b(a.position);
-	for (int i = 0; i < pixels; ++i)
+	for (int i = 0; i < int(triangles.size()); ++i)
 	{
-        line[i] = Pixel { int(current_a.x), int(current_a.y), current_a.z, current_b };
-		current_a += step_a;
-        current_b += step_b;
+        const Triangle& triangle = triangles[i];
+        ProcessTriangle(window, camera, triangle, [&](const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c) {
+            if (mode == RasterMode::EDGE)
+            {
+                // NOTE: Writes straight to the depth buffer and the window; nothing is allocated.
+                // Blocks of pixels where the triangle is hidden are skipped as a whole.
+                RasterizeTriangle(a, b, c, depth_buffer, [&](const Pixel& pixel) {
+                    OutputFragment(window, shading, pixel, i, triangle);
+                });
+                return;
+            }
+
+            // NOTE: The vectors of a triangle are freed when it's drawn, so the next one reuses their memory.
+            Arena::Marker marker = frame_arena.mark();
+
+            {
+                ArenaVector<Pixel> polygon({ ToPixel(window, a), ToPixel(window, b), ToPixel(window, c) }, ArenaAllocator<Pixel>(frame_arena));
+                ArenaVector<Pixel> pixels = Rasterize(frame_arena, polygon);
+
+                for (const Pixel& pixel : pixels)
+                {
+                    float& depth = depth_buffer.at(pixel.x, pixel.y);
+                    if (depth < pixel.z_inv)
+                    {
+                        depth = pixel.z_inv;
+                        OutputFragment(window, shading, pixel, i, triangle);
+                    }
+                }
+            }
+            frame_arena.rewind(marker);
+        });
 	}
-
-    return line;
 }
 
-Pixel VertexShader(const Camera& camera, const Vertex& v)
+/// Sort-middle version of `Draw`. The triangles are culled and clipped on all threads, and
+/// the triangles left are binned into screen tiles in their original order. Then each tile is
+/// cleared and rasterized on its own by one thread, into its own pixels and depth buffer,
+/// so no pixel is ever written by two threads and nothing needs a lock.
+///
+/// Each tile draws its triangles in the same order as `Draw`, so the image is the same.
+void DrawTiled(ThreadPool& pool, TileBinner& binner, ClippedTriangles& clipped, Window& window, const Camera& camera, const vector<Triangle>& triangles, ShadingMode shading)
 {
-    float f = -SCREEN_HEIGHT;
-    vec3 p = camera.transform * (v.position - camera.position);
-    auto x = int(f * p.x / p.z + (SCREEN_WIDTH  - 1) / 2.0f);
-    auto y = int(f * p.y / p.z + (SCREEN_HEIGHT - 1) / 2.0f);
+    int count = int(triangles.size());
+    clipped.vertices.resize(3 * size_t(MAX_CLIPPED_TRIANGLES) * size_t(count));
+    clipped.counts.resize(size_t(count));
+
+    pool.parallel_for(count, [&](int i) {
+        ScreenVertex* slot = &clipped.vertices[3 * size_t(MAX_CLIPPED_TRIANGLES) * size_t(i)];
+        clipped.counts[i] = ProcessTriangle(window, camera, triangles[i], [&](const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c) {
+            *slot++ = a;
+            *slot++ = b;
+            *slot++ = c;
+        });
+    });
+
+    // NOTE: The bins hold slots, so the model triangle of slot `s` is `s / MAX_CLIPPED_TRIANGLES`.
+    binner.begin_frame(window.width(), window.height());
+    for (int i = 0; i < count; ++i)
+    {
+        for (int k = 0; k < clipped.counts[i]; ++k)
+        {
+            int slot = i * MAX_CLIPPED_TRIANGLES + k;
+            binner.add(slot, clipped.vertices[3 * slot + 0], clipped.vertices[3 * slot + 1], clipped.vertices[3 * slot + 2]);
+        }
+    }
 
-    auto result = glm::clamp(ivec2(x, y), ivec2(0, 0), ivec2(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1));
-    return { result.x, result.y, -1.0f / p.z, p };
+    pool.parallel_for(binner.tile_count(), [&](int tile) {
+        int x_min, y_min, x_max, y_max;
+        binner.bounds(tile, x_min, y_min, x_max, y_max);
+
+        HierarchicalDepth& depth = binner.tile_depth(tile);
+        depth.clear();
+        if (shading == ShadingMode::DEFERRED)
+            g_buffer.clear(x_min, y_min, x_max, y_max);
+        else
+            for (int y = y_min; y < y_max; ++y)
+            {
+                auto row = color_buffer.begin() + size_t(y) * size_t(window.width());
+                std::fill(row + x_min, row + x_max, BLACK);
+            }
+
+        for (int slot : binner.triangles(tile))
+        {
+            int index = slot / MAX_CLIPPED_TRIANGLES;
+            RasterizeTriangle(clipped.vertices[3 * slot + 0], clipped.vertices[3 * slot + 1], clipped.vertices[3 * slot + 2], depth, [&](const Pixel& pixel) {
+                OutputFragment(window, shading, pixel, index, triangles[index]);
+            });
+        }
+    });
 }
 
-vector<Pixel> Rasterize(const vector<Pixel>& polygon)
+
+/// The lighting pass of deferred shading: lights every pixel of the G-buffer exactly once,
+/// however many triangles were drawn over it, into the color buffer. The rows are lit on
+/// the threads of `pool`, or on this thread if it's null.
+void LightingPass(ThreadPool* pool, Window& window, const vector<Triangle>& triangles)
 {
-    auto[left, right] = ComputePolygonRows(polygon);
-    vector<Pixel> pixels;
-    pixels.reserve(left.size());
-    for (int row = 0; row < left.size(); ++row)
-        for (const Pixel& pixel : Interpolate(left[row], right[row]))
-            pixels.push_back(pixel);
-
-    return pixels;
+    PointLight light = { light_position, light_power };
+
+    auto light_row = [&](int y) {
+        vec3* colors    = &color_buffer[size_t(y) * size_t(window.width())];
+        auto  normal_of = [&](int index) { return triangles[index].normal; };
+        LightRow(g_buffer, y, light, normal_of, [&](int x, int index, float falloff) {
+            colors[x] = index == GBuffer::EMPTY ? BLACK : Illuminate(triangles[index], falloff);
+        });
+    };
+
+    if (pool != nullptr)
+        pool->parallel_for(g_buffer.height(), light_row);
+    else
+        for (int y = 0; y < g_buffer.height(); ++y)
+            light_row(y);
 }
 
-void PixelShader(Window& window, const Pixel& pixel, const Triangle& triangle) {
-    if (depth_buffer[pixel.y][pixel.x] < pixel.z_inv) {
-        depth_buffer[pixel.y][pixel.x] = pixel.z_inv;
-
-        // Reflectance
-        const vec3  vertex_to_light    = light_position - pixel.position;
-        const vec3  direction_to_light = normalize(vertex_to_light);
-        const float radius = length(vertex_to_light);
 
-        const float factor = max(dot(direction_to_light, triangle.normal), 0.0f);
-
-        const vec3 specular = (factor * light_power) / (4.0f * float(M_PI) * radius * radius);
-        const vec3 illumination = specular + indirect_light_power_per_area;
+/// Moves the vertex in front of the camera, before the perspective divide. The camera looks
+/// down -z, so `w` is `-z`, and the focal length is the height of the window.
+ClipVertex VertexShader(const Window& window, const Camera& camera, const Vertex& v)
+{
+    int width  = window.width();
+    int height = window.height();
 
+    vec3  p = camera.transform * (v.position - camera.position);
+    float w = -p.z;
+    vec2  center((width - 1) / 2.0f, (height - 1) / 2.0f);
 
-        window.set_pixel(pixel.x, pixel.y, clamp(triangle.color * illumination, vec3(0), vec3(1)));
-    }
+    return { vec3(float(height) * vec2(p.x, p.y) + w * center, w), p };
 }
 
-
-
-
-tuple<vector<Pixel>, vector<Pixel>> ComputePolygonRows(const vector<Pixel>& vertexPixels)
+/// Culls the triangle if it faces away from the camera, and otherwise shades its vertices and
+/// culls and clips it with `ClipTriangle`, calling `emit` for each screen triangle left.
+template <typename Emit>
+int ProcessTriangle(const Window& window, const Camera& camera, const Triangle& triangle, Emit&& emit)
 {
-    const int vertexCount = vertexPixels.size();
-
-	vector<float> yvalues(vertexCount);
-	for (int i = 0; i < vertexCount; ++i)
-		yvalues[i] = vertexPixels[i].y;
-
-
-	// Calculates max and min.
-	auto max = std::max_element(yvalues.begin(), yvalues.end());
-	auto min = std::min_element(yvalues.begin(), yvalues.end());
-
-//	std::cout << "Y-values: " << *min << " - " << *max << std::endl;
-
-	// Calculates number of rows according to the given formulas.
-	auto numberOfRows = int(*max - *min) + 1;
-
-//	std::cout << numberOfRows << std::endl;
-
-    vector<Pixel> left(numberOfRows);
-    vector<Pixel> right(numberOfRows);
-
-	for (int i = 0; i < numberOfRows; ++i)
-	{
-        left[i].x  = std::numeric_limits<int>::max();
-        right[i].x = std::numeric_limits<int>::min();
-	}
-
-	for (int i = 0; i < vertexCount; ++i)
-	{
-        int j = (i + 1) % vertexCount;
+    // NOTE: The normals point to the side of the triangle that is lit and looked at.
+    if (dot(triangle.normal, camera.position - triangle.v0) <= 0.0f)
+        return 0;
+
+    return ClipTriangle(
+        VertexShader(window, camera, Vertex { triangle.v0 }),
+        VertexShader(window, camera, Vertex { triangle.v1 }),
+        VertexShader(window, camera, Vertex { triangle.v2 }),
+        window.width(), window.height(), emit
+    );
+}
 
-		auto v0 = vertexPixels[i];
-		auto v1 = vertexPixels[j];
+/// Rounds the vertex to a pixel for `Rasterize`, which only handles vertices on the screen.
+Pixel ToPixel(const Window& window, const ScreenVertex& v)
+{
+    auto x = int(v.screen.x);
+    auto y = int(v.screen.y);
 
-		auto line = Interpolate(v0, v1);
+    auto result = glm::clamp(ivec2(x, y), ivec2(0, 0), ivec2(window.width() - 1, window.height() - 1));
+    return { result.x, result.y, v.z_inv, v.position };
+}
 
-		for (const auto v : line) {
+/// Lights the fragment of triangle `index` now, or stores it in the G-buffer to be lit by
+/// `LightingPass`. It has already passed the depth test.
+void OutputFragment(Window& window, ShadingMode shading, const Pixel& pixel, int index, const Triangle& triangle)
+{
+    if (shading == ShadingMode::DEFERRED)
+        g_buffer.write(pixel.x, pixel.y, index, pixel.position);
+    else
+        PixelShader(window, pixel, triangle);
+}
 
-		    int row = int(v.y - *min + 0.5f);
+/// Lights the pixel. It has already passed the depth test.
+void PixelShader(Window& window, const Pixel& pixel, const Triangle& triangle) {
+    const float falloff = Falloff(PointLight { light_position, light_power }, pixel.position, triangle.normal);
 
-		    auto& a = left[row];
-            auto& b = right[row];
+    color_buffer[size_t(pixel.y) * size_t(window.width()) + size_t(pixel.x)] = Illuminate(triangle, falloff);
+}
 
-            if (a.x > v.x) { a = v; }
-            if (b.x < v.x) { b = v; }
-		}
-	}
+/// The color of a surface of `triangle` that gets `falloff` of the light (see `Falloff`).
+vec3 Illuminate(const Triangle& triangle, float falloff) {
+    // Reflectance
+    const vec3 specular     = falloff * light_power;
+    const vec3 illumination = specular + indirect_light_power_per_area;
 
-	return { left, right };
+    return clamp(triangle.color * illumination, vec3(0), vec3(1));
 }
@@ -0,0 +1,159 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Memory for everything that only lives for one frame, taken from one block by
+// moving an offset, and given back all at once by moving it back.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+
+/// A bump allocator. `allocate` hands out the memory after the last allocation, and
+/// `reset` frees everything at once, so nothing is freed on its own.
+///
+/// If a frame needs more than the block holds, more blocks are allocated for it, and the
+/// next `reset` replaces them all with one block big enough for the whole frame. Only
+/// once the arena has warmed up like this, and has a single block, is `reset` O(1) and
+/// does a frame allocate nothing from the heap at all.
+///
+/// Not thread safe: each thread that allocates needs an arena of its own.
+class Arena
+{
+public:
+	explicit Arena(size_t capacity = 1 << 20) { this->add_block(std::max(capacity, size_t(1))); }
+
+	Arena(const Arena&) = delete;
+	Arena& operator= (const Arena&) = delete;
+
+	/// `bytes` bytes aligned to `alignment`, which must be a power of two.
+	void* allocate(size_t bytes, size_t alignment)
+	{
+		Block& block = this->blocks.back();
+		uintptr_t base  = reinterpret_cast<uintptr_t>(block.memory.get());
+		uintptr_t start = (base + this->offset + alignment - 1) & ~uintptr_t(alignment - 1);
+
+		if (start + bytes > base + block.size)
+		{
+			// NOTE: The new block is big enough even if its memory is badly aligned.
+			this->add_block(std::max(bytes + alignment, 2 * block.size));
+			return this->allocate(bytes, alignment);
+		}
+
+		this->offset  = size_t(start + bytes - base);
+		this->in_use += bytes;
+		return reinterpret_cast<void*>(start);
+	}
+
+	/// Where the arena is, to free everything allocated after it with `rewind`.
+	struct Marker
+	{
+		size_t block;
+		size_t offset;
+		size_t in_use;
+	};
+
+	Marker mark() const { return { this->blocks.size() - 1, this->offset, this->in_use }; }
+
+	/// Frees everything allocated since `marker`, which lets memory that only lives for a
+	/// part of the frame be used again within it. If a block was added since, the memory is
+	/// kept until `reset` instead.
+	void rewind(const Marker& marker)
+	{
+		if (marker.block + 1 == this->blocks.size())
+		{
+			this->offset = marker.offset;
+			this->in_use = marker.in_use;
+		}
+	}
+
+	/// Frees everything allocated so far.
+	void reset()
+	{
+		// NOTE: Only happens while the frames are still getting bigger. It frees every block
+		// and allocates one new one, so this reset is not O(1).
+		if (this->blocks.size() > 1)
+		{
+			size_t total = 0;
+			for (const Block& block : this->blocks)
+				total += block.size;
+
+			this->blocks.clear();
+			this->add_block(total);
+		}
+
+		this->offset = 0;
+		this->in_use = 0;
+	}
+
+	/// The bytes allocated since the last `reset`, without the padding for alignment.
+	size_t used() const { return this->in_use; }
+
+	/// The bytes of all blocks.
+	size_t capacity() const
+	{
+		size_t total = 0;
+		for (const Block& block : this->blocks)
+			total += block.size;
+		return total;
+	}
+
+	int block_count() const { return int(this->blocks.size()); }
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> memory;
+		size_t                           size;
+	};
+
+	void add_block(size_t size)
+	{
+		this->blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+		this->offset = 0;
+	}
+
+	std::vector<Block> blocks;      // Allocations are taken from the last one.
+	size_t             offset = 0;  // Of the free memory in the last block.
+	size_t             in_use = 0;
+};
+
+
+/// Lets standard containers take their memory from an `Arena`. Deallocating does
+/// nothing; the memory comes back when the arena is reset, so the containers must not
+/// be used after that.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(this->arena->allocate(count * sizeof(T), alignof(T))); }
+
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return this->arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return this->arena != other.arena; }
+
+private:
+	template <typename U>
+	friend class ArenaAllocator;
+
+	Arena* arena;
+};
+
+/// A vector in an `Arena`. Reserve it up front where the size is known, since growing
+/// leaves the old elements behind in the arena until it is reset.
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Frame time statistics for the labs' benchmark mode, written out as JSON
+// so that runs on different commits can be compared.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+
+/// Times the frames of one benchmark run. Each frame also reports how much
+/// work it did (rays, triangles, ...), which is summed into a throughput.
+///
+/// The first `warmup_frames` frames are timed but not recorded, so caches and
+/// lazily created resources don't skew the results.
+class Benchmark
+{
+public:
+	struct Summary
+	{
+		int    frames;
+		double mean;    // Seconds.
+		double median;
+		double p95;
+		double p99;
+		double min;
+		double max;
+		double throughput;  // Work per second.
+	};
+
+	Benchmark(std::string name, std::string unit, int warmup_frames = 1)
+		: name(std::move(name)), unit(std::move(unit)), warmup_frames(warmup_frames) {}
+
+	/// Renders and times one frame.
+	template <typename Render>
+	void frame(double work, Render&& render)
+	{
+		auto start = std::chrono::steady_clock::now();
+		render();
+		auto stop  = std::chrono::steady_clock::now();
+
+		this->record(std::chrono::duration<double>(stop - start).count(), work);
+	}
+
+	void record(double seconds, double work)
+	{
+		if (this->skipped < this->warmup_frames)
+		{
+			this->skipped += 1;
+			return;
+		}
+
+		this->frame_times.push_back(seconds);
+		this->total_work += work;
+	}
+
+	/// Adds a parameter of the run (like the resolution) to the JSON output.
+	void set(const std::string& key, double value)
+	{
+		char buffer[64];
+		std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+		this->parameters.emplace_back(key, buffer);
+	}
+
+	void set(const std::string& key, const std::string& value)
+	{
+		this->parameters.emplace_back(key, '"' + value + '"');
+	}
+
+	Summary summary() const
+	{
+		Summary summary = { int(frame_times.size()), 0, 0, 0, 0, 0, 0, 0 };
+		if (frame_times.empty())
+			return summary;
+
+		std::vector<double> sorted = frame_times;
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0;
+		for (double seconds : sorted)
+			total += seconds;
+
+		summary.mean       = total / double(sorted.size());
+		summary.median     = Percentile(sorted, 50);
+		summary.p95        = Percentile(sorted, 95);
+		summary.p99        = Percentile(sorted, 99);
+		summary.min        = sorted.front();
+		summary.max        = sorted.back();
+		summary.throughput = total > 0 ? total_work / total : 0;
+		return summary;
+	}
+
+	std::string json() const
+	{
+		Summary s = this->summary();
+
+		std::string result = "{\n";
+		result += "  \"benchmark\": \"" + name + "\",\n";
+		for (const auto& parameter : parameters)
+			result += "  \"" + parameter.first + "\": " + parameter.second + ",\n";
+
+		char buffer[512];
+		std::snprintf(buffer, sizeof(buffer),
+			"  \"frames\": %d,\n"
+			"  \"frame_time_ms\": { \"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f },\n"
+			"  \"%s_per_second\": %.1f\n",
+			s.frames, 1000 * s.mean, 1000 * s.median, 1000 * s.p95, 1000 * s.p99, 1000 * s.min, 1000 * s.max,
+			unit.c_str(), s.throughput);
+
+		return result + buffer + "}\n";
+	}
+
+	/// Writes `json()` to `path`. Returns false if the file couldn't be written.
+	bool save(const std::string& path) const
+	{
+		FILE* file = std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+			return false;
+
+		std::string text = this->json();
+		bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+		return std::fclose(file) == 0 && written;
+	}
+
+	/// The nearest-rank percentile of an ascending, non-empty list.
+	static double Percentile(const std::vector<double>& sorted, double percent)
+	{
+		auto rank = size_t(std::ceil(percent / 100.0 * double(sorted.size())));
+		return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+	}
+
+private:
+	std::string name;
+	std::string unit;
+	int         warmup_frames;
+	int         skipped = 0;
+
+	std::vector<double> frame_times;
+	double              total_work = 0;
+
+	std::vector<std::pair<std::string, std::string>> parameters;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef COLOR_CONVERSION_H
+#define COLOR_CONVERSION_H
+
+// Batch conversion of float RGB colors to packed ARGB8888 pixels, for turning
+// a whole frame of colors into the pixels of a window in one pass.
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "Simd.h"
+
+
+/// Maps a channel in [0, 1] to 8 bits through `pow(value, 1 / gamma)`, with the
+/// channel quantized to `SIZE` steps first.
+class GammaTable
+{
+public:
+	static const int SIZE = 4096;
+
+	static GammaTable Create(float gamma)
+	{
+		GammaTable table;
+		for (int i = 0; i < SIZE; ++i)
+		{
+			float value = std::pow(float(i) / float(SIZE - 1), 1.0f / gamma);
+			table.entries[i] = uint8_t(std::min(value * 255.0f + 0.5f, 255.0f));
+		}
+		return table;
+	}
+
+	/// The entry of a channel value. Values outside [0, 1] are clamped, and NaN is 0.
+	static int Index(float value)
+	{
+		return int(Saturate(value) * float(SIZE - 1));
+	}
+
+	/// Clamps `value` to [0, 1], with NaN as 0.
+	static float Saturate(float value)
+	{
+		return value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+	}
+
+	uint8_t operator[](int index) const { return entries[index]; }
+
+private:
+	uint8_t entries[SIZE];
+};
+
+
+/// Packs 8-bit channels as ARGB8888, with an opaque alpha.
+inline uint32_t PackARGB(uint32_t r, uint32_t g, uint32_t b)
+{
+	return (255u << 24) | (r << 16) | (g << 8) | b;
+}
+
+/// The same as `ColorCode`, i.e. each channel is scaled by 255 and truncated, except
+/// that channels outside [0, 1] are clamped instead of asserted on.
+inline uint32_t ConvertToARGB(const glm::vec3& color)
+{
+	auto channel = [](float value) { return uint32_t(GammaTable::Saturate(value) * 255.0f); };
+	return PackARGB(channel(color.r), channel(color.g), channel(color.b));
+}
+
+inline uint32_t ConvertToARGB(const glm::vec3& color, const GammaTable& gamma)
+{
+	return PackARGB(gamma[GammaTable::Index(color.r)], gamma[GammaTable::Index(color.g)], gamma[GammaTable::Index(color.b)]);
+}
+
+
+#if SIMD_X86
+
+/// Loads the colors of 4 pixels, `r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3`, and
+/// shuffles them to one register per channel.
+inline void LoadChannelsSSE(const glm::vec3* colors, __m128& r, __m128& g, __m128& b)
+{
+	const float* p = &colors[0].x;
+	__m128 m0 = _mm_loadu_ps(p + 0);
+	__m128 m1 = _mm_loadu_ps(p + 4);
+	__m128 m2 = _mm_loadu_ps(p + 8);
+
+	__m128 b1r2b2r3 = _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(1, 0, 2, 1));
+	r = _mm_shuffle_ps(m0, b1r2b2r3, _MM_SHUFFLE(3, 1, 3, 0));
+
+	__m128 g0g0g1g1 = _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(0, 0, 1, 1));
+	__m128 g2g2g3g3 = _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 2, 3, 3));
+	g = _mm_shuffle_ps(g0g0g1g1, g2g2g3g3, _MM_SHUFFLE(2, 0, 2, 0));
+
+	__m128 b1b2b3b3 = _mm_shuffle_ps(b1r2b2r3, m2, _MM_SHUFFLE(3, 3, 2, 0));
+	__m128 b0b0b1b2 = _mm_shuffle_ps(m0, b1b2b3b3, _MM_SHUFFLE(1, 0, 2, 2));
+	b = _mm_shuffle_ps(b0b0b1b2, b1b2b3b3, _MM_SHUFFLE(2, 1, 2, 0));
+}
+
+/// Clamps each lane to [0, 1], with NaN as 0.
+inline __m128 SaturateSSE(__m128 value)
+{
+	// NOTE: `max` returns its second operand if either is NaN.
+	return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+/// Converts 4 pixels, given as one register per channel. The channels are truncated to
+/// integers, and then the saturating packs narrow them to bytes, which the unpacks
+/// interleave to `b g r a` order.
+inline void ConvertToARGBSSE(__m128 r, __m128 g, __m128 b, uint32_t* pixels)
+{
+	const __m128 scale = _mm_set1_ps(255.0f);
+
+	__m128i ri = _mm_cvttps_epi32(_mm_mul_ps(SaturateSSE(r), scale));
+	__m128i gi = _mm_cvttps_epi32(_mm_mul_ps(SaturateSSE(g), scale));
+	__m128i bi = _mm_cvttps_epi32(_mm_mul_ps(SaturateSSE(b), scale));
+	__m128i ai = _mm_set1_epi32(255);
+
+	__m128i b_g = _mm_packs_epi32(bi, gi);  // b0 b1 b2 b3 g0 g1 g2 g3
+	__m128i r_a = _mm_packs_epi32(ri, ai);  // r0 r1 r2 r3 a0 a1 a2 a3
+	__m128i bg  = _mm_unpacklo_epi16(b_g, _mm_unpackhi_epi64(b_g, b_g));  // b0 g0 b1 g1 ...
+	__m128i ra  = _mm_unpacklo_epi16(r_a, _mm_unpackhi_epi64(r_a, r_a));  // r0 a0 r1 a1 ...
+
+	__m128i low  = _mm_unpacklo_epi32(bg, ra);  // b0 g0 r0 a0 b1 g1 r1 a1
+	__m128i high = _mm_unpackhi_epi32(bg, ra);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), _mm_packus_epi16(low, high));
+}
+
+inline void ConvertToARGBSSE(const glm::vec3* colors, uint32_t* pixels)
+{
+	__m128 r, g, b;
+	LoadChannelsSSE(colors, r, g, b);
+	ConvertToARGBSSE(r, g, b, pixels);
+}
+
+/// Converts 4 pixels through `gamma`. Only the table indices are computed 4 at a time.
+inline void ConvertToARGBSSE(const glm::vec3* colors, uint32_t* pixels, const GammaTable& gamma)
+{
+	const __m128 scale = _mm_set1_ps(float(GammaTable::SIZE - 1));
+
+	__m128 r, g, b;
+	LoadChannelsSSE(colors, r, g, b);
+
+	alignas(16) int32_t index[3][4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(index[0]), _mm_cvttps_epi32(_mm_mul_ps(SaturateSSE(r), scale)));
+	_mm_store_si128(reinterpret_cast<__m128i*>(index[1]), _mm_cvttps_epi32(_mm_mul_ps(SaturateSSE(g), scale)));
+	_mm_store_si128(reinterpret_cast<__m128i*>(index[2]), _mm_cvttps_epi32(_mm_mul_ps(SaturateSSE(b), scale)));
+
+	for (int i = 0; i < 4; ++i)
+		pixels[i] = PackARGB(gamma[index[0][i]], gamma[index[1][i]], gamma[index[2][i]]);
+}
+
+#endif
+
+
+/// Converts `count` colors to ARGB8888 pixels, like `ConvertToARGB`, 4 at a time with
+/// SSE where available. If `gamma` isn't null, the channels are mapped through it.
+inline void ConvertToARGB(const glm::vec3* colors, uint32_t* pixels, int count, const GammaTable* gamma = nullptr)
+{
+	int i = 0;
+
+#if SIMD_X86
+	if (gamma == nullptr)
+		for (; i + 4 <= count; i += 4)
+			ConvertToARGBSSE(colors + i, pixels + i);
+	else
+		for (; i + 4 <= count; i += 4)
+			ConvertToARGBSSE(colors + i, pixels + i, *gamma);
+#endif
+
+	for (; i < count; ++i)
+		pixels[i] = gamma == nullptr ? ConvertToARGB(colors[i]) : ConvertToARGB(colors[i], *gamma);
+}
+
+
+/// A bilinear gradient between the colors at the four corners of a rectangle.
+struct Gradient
+{
+	glm::vec3 top_left;
+	glm::vec3 top_right;
+	glm::vec3 bottom_left;
+	glm::vec3 bottom_right;
+};
+
+/// Writes row `y` of `gradient` stretched over `width` x `height` pixels to `pixels`, as
+/// ARGB8888 like `ConvertToARGB`, without building the colors in memory first.
+///
+/// Like `Interpolate`, pixel `i` of `n` is at `i / n` of the way, so the bottom and right
+/// colors are where the row and column after the last would be. Each pixel is computed
+/// from its own position instead of adding up a step, so every row comes out the same no
+/// matter how long it is, and the SSE path gives the same pixels as the scalar one.
+inline void GradientRow(const Gradient& gradient, int y, int width, int height, uint32_t* pixels)
+{
+	auto lerp = [](const glm::vec3& start, const glm::vec3& stop, float t) { return start * (1.0f - t) + stop * t; };
+
+	float     t     = float(y) / float(height);
+	glm::vec3 left  = lerp(gradient.top_left,  gradient.bottom_left,  t);
+	glm::vec3 right = lerp(gradient.top_right, gradient.bottom_right, t);
+
+	int x = 0;
+
+#if SIMD_X86
+	const __m128 one   = _mm_set1_ps(1.0f);
+	const __m128 count = _mm_set1_ps(float(width));
+	const __m128 lr = _mm_set1_ps(left.r),  lg = _mm_set1_ps(left.g),  lb = _mm_set1_ps(left.b);
+	const __m128 rr = _mm_set1_ps(right.r), rg = _mm_set1_ps(right.g), rb = _mm_set1_ps(right.b);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128 s = _mm_div_ps(_mm_setr_ps(float(x), float(x + 1), float(x + 2), float(x + 3)), count);
+		__m128 u = _mm_sub_ps(one, s);
+
+		__m128 r = _mm_add_ps(_mm_mul_ps(lr, u), _mm_mul_ps(rr, s));
+		__m128 g = _mm_add_ps(_mm_mul_ps(lg, u), _mm_mul_ps(rg, s));
+		__m128 b = _mm_add_ps(_mm_mul_ps(lb, u), _mm_mul_ps(rb, s));
+		ConvertToARGBSSE(r, g, b, pixels + x);
+	}
+#endif
+
+	for (; x < width; ++x)
+		pixels[x] = ConvertToARGB(lerp(left, right, float(x) / float(width)));
+}
+
+#endif
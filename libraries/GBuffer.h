@@ -0,0 +1,154 @@
+#ifndef G_BUFFER_H
+#define G_BUFFER_H
+
+// Storage for deferred shading. The geometry pass writes what is visible at each
+// pixel to a `GBuffer`, and the lighting pass then lights every pixel exactly once,
+// a row at a time, no matter how many triangles were drawn over it.
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "Simd.h"
+
+
+/// The index of the visible triangle and its interpolated position at each pixel,
+/// stored as one array per component so a row can be lit several pixels at a time.
+class GBuffer
+{
+public:
+	/// The triangle index of pixels that nothing was drawn to.
+	static constexpr int EMPTY = -1;
+
+	void resize(int width, int height)
+	{
+		this->buffer_width  = width;
+		this->buffer_height = height;
+
+		size_t size = size_t(width) * size_t(height);
+		triangle.resize(size);
+		position_x.resize(size);
+		position_y.resize(size);
+		position_z.resize(size);
+	}
+
+	/// Empties the pixels `[x_min, x_max) x [y_min, y_max)`.
+	void clear(int x_min, int y_min, int x_max, int y_max)
+	{
+		for (int y = y_min; y < y_max; ++y)
+			std::fill(triangle.begin() + index(x_min, y), triangle.begin() + index(x_max, y), EMPTY);
+	}
+
+	void clear() { this->clear(0, 0, buffer_width, buffer_height); }
+
+	void write(int x, int y, int triangle_index, const glm::vec3& position)
+	{
+		size_t i = index(x, y);
+		triangle[i]   = triangle_index;
+		position_x[i] = position.x;
+		position_y[i] = position.y;
+		position_z[i] = position.z;
+	}
+
+	int width()  const { return buffer_width;  }
+	int height() const { return buffer_height; }
+
+	/// The start of row `row` of each component.
+	const int*   triangles(int row) const { return &triangle[index(0, row)];   }
+	const float* x(int row)         const { return &position_x[index(0, row)]; }
+	const float* y(int row)         const { return &position_y[index(0, row)]; }
+	const float* z(int row)         const { return &position_z[index(0, row)]; }
+
+private:
+	size_t index(int x, int y) const { return size_t(y) * size_t(buffer_width) + size_t(x); }
+
+	int buffer_width  = 0;
+	int buffer_height = 0;
+
+	std::vector<int>   triangle;
+	std::vector<float> position_x;
+	std::vector<float> position_y;
+	std::vector<float> position_z;
+};
+
+
+/// A light at `position` that sends `power` evenly in all directions.
+struct PointLight
+{
+	glm::vec3 position;
+	glm::vec3 power;
+};
+
+
+/// The part of `light`'s power that reaches a surface at `position` with the normal
+/// `normal`, per unit of area: `max(cos θ, 0) / (4π r²)`.
+inline float Falloff(const PointLight& light, const glm::vec3& position, const glm::vec3& normal)
+{
+	glm::vec3 to_light = light.position - position;
+	float squared = glm::dot(to_light, to_light);
+	float cosine  = glm::dot(to_light, normal) / std::sqrt(squared);
+	return std::max(cosine, 0.0f) / (4.0f * float(M_PI) * squared);
+}
+
+
+/// Calls `shade(x, triangle, falloff)` for every pixel of row `y` in order, with the
+/// `Falloff` of `light` at the pixel, or with `GBuffer::EMPTY` and 0 for empty pixels.
+/// `normal_of(triangle)` returns the normal of a triangle.
+///
+/// The falloff is computed for 4 pixels at a time with SSE, where available.
+template <typename NormalOf, typename Shade>
+void LightRow(const GBuffer& g_buffer, int y, const PointLight& light, NormalOf&& normal_of, Shade&& shade)
+{
+	const int*   triangles = g_buffer.triangles(y);
+	const float* px = g_buffer.x(y);
+	const float* py = g_buffer.y(y);
+	const float* pz = g_buffer.z(y);
+
+	int width = g_buffer.width();
+	int x     = 0;
+
+#if SIMD_X86
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 four_pi = _mm_set1_ps(4.0f * float(M_PI));
+	const __m128 lx = _mm_set1_ps(light.position.x), ly = _mm_set1_ps(light.position.y), lz = _mm_set1_ps(light.position.z);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		// NOTE: Empty pixels are lit with a zero normal, and then ignored.
+		glm::vec3 n[4];
+		for (int i = 0; i < 4; ++i)
+			n[i] = triangles[x + i] == GBuffer::EMPTY ? glm::vec3(0) : normal_of(triangles[x + i]);
+
+		__m128 dx = _mm_sub_ps(lx, _mm_loadu_ps(px + x));
+		__m128 dy = _mm_sub_ps(ly, _mm_loadu_ps(py + x));
+		__m128 dz = _mm_sub_ps(lz, _mm_loadu_ps(pz + x));
+		__m128 nx = _mm_setr_ps(n[0].x, n[1].x, n[2].x, n[3].x);
+		__m128 ny = _mm_setr_ps(n[0].y, n[1].y, n[2].y, n[3].y);
+		__m128 nz = _mm_setr_ps(n[0].z, n[1].z, n[2].z, n[3].z);
+
+		__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 cosine  = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)), _mm_mul_ps(dz, nz)), _mm_sqrt_ps(squared));
+		__m128 falloff = _mm_div_ps(_mm_max_ps(cosine, zero), _mm_mul_ps(four_pi, squared));
+
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, falloff);
+		for (int i = 0; i < 4; ++i)
+		{
+			int triangle = triangles[x + i];
+			shade(x + i, triangle, triangle == GBuffer::EMPTY ? 0.0f : lanes[i]);
+		}
+	}
+#endif
+
+	for (; x < width; ++x)
+	{
+		int triangle = triangles[x];
+		if (triangle == GBuffer::EMPTY)
+			shade(x, triangle, 0.0f);
+		else
+			shade(x, triangle, Falloff(light, glm::vec3(px[x], py[x], pz[x]), normal_of(triangle)));
+	}
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+// Ranges of evenly spaced values that are computed as they are used, instead of
+// being stored in a vector first, and exact integer stepping for pixel coordinates.
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "Simd.h"
+
+
+/// Iterates over any range with `operator[]` and `size`, by index. The values are
+/// made by the range when the iterator is dereferenced, so they're returned by value.
+template <typename Range>
+class IndexIterator
+{
+public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type        = decltype(std::declval<const Range&>()[0]);
+	using difference_type   = std::ptrdiff_t;
+	using pointer           = void;
+	using reference         = value_type;
+
+	IndexIterator(const Range* range, int index) : range(range), index(index) {}
+
+	value_type operator*() const { return (*range)[index]; }
+
+	IndexIterator& operator++()    { ++index; return *this; }
+	IndexIterator  operator++(int) { IndexIterator old = *this; ++index; return old; }
+
+	bool operator==(const IndexIterator& other) const { return index == other.index; }
+	bool operator!=(const IndexIterator& other) const { return index != other.index; }
+
+private:
+	const Range* range;
+	int          index;
+};
+
+
+/// `count` values, where value `i` is `start + step * i`. Each value is computed from
+/// its index, so no error adds up along the range, and any group of values can be
+/// computed at once, like 4 floats with `LoadSSE`.
+///
+/// `T` is a float or a glm vector.
+template <typename T>
+class Interpolation
+{
+public:
+	using Iterator = IndexIterator<Interpolation<T>>;
+
+	Interpolation(const T& start, const T& step, int count)
+		: first(start), delta(step), count(std::max(count, 0)) {}
+
+	/// `count` values from `start` to `stop`, with both included, or only `start` if
+	/// `count` is 1.
+	static Interpolation Between(const T& start, const T& stop, int count)
+	{
+		return Interpolation(start, (stop - start) / float(std::max(count - 1, 1)), count);
+	}
+
+	T operator[](int i) const { return first + delta * float(i); }
+
+	int size() const { return count; }
+
+	const T& start() const { return first; }
+	const T& step()  const { return delta; }
+
+	Iterator begin() const { return Iterator(this, 0); }
+	Iterator end()   const { return Iterator(this, count); }
+
+	/// The values of one component of a vector range, as a range of their own.
+	Interpolation<float> component(int c) const { return Interpolation<float>(first[c], delta[c], count); }
+
+private:
+	T   first;
+	T   delta;
+	int count;
+};
+
+
+/// Steps exactly from integer `start` to `stop` in `steps` equal steps, so that value
+/// `i` is `floor(start + (stop - start) * i / steps)`, for up to `MAX_STEPS` steps.
+///
+/// The value is kept in 32.32 fixed point, with the step rounded up. The error that adds
+/// up is then less than `steps / 2^32`, which is less than the `1 / steps` that a value
+/// that isn't a whole number is at least away from the next one, so each value still
+/// rounds down to the right integer. Floats can land a hair below an integer and skip it
+/// (see `question.txt`), but this can't, so when `stop - start` is `steps`, every integer
+/// on the way comes up exactly once. A step is a single integer add.
+class Dda
+{
+public:
+	static const int MAX_STEPS = 65535;
+
+	Dda(int start, int stop, int steps)
+		: position(Fixed(start)), delta(Step(start, stop, steps)) {}
+
+	int value() const { return int(position >> 32); }
+
+	void next() { position += delta; }
+
+	/// Value `i` of the steps, without stepping there. The same as stepping `i` times.
+	static int At(int start, int stop, int steps, int i)
+	{
+		return int((Fixed(start) + Step(start, stop, steps) * int64_t(i)) >> 32);
+	}
+
+	/// `a / b` rounded down, for `b > 0`.
+	template <typename Integer>
+	static Integer FloorDivide(Integer a, Integer b)
+	{
+		Integer quotient = a / b;
+		return quotient - Integer(a % b != 0 && a < 0);
+	}
+
+private:
+	static int64_t Fixed(int value) { return int64_t(value) * (int64_t(1) << 32); }
+
+	/// `(stop - start) / steps` in 32.32 fixed point, rounded up.
+	static int64_t Step(int start, int stop, int steps)
+	{
+		return -FloorDivide(-Fixed(stop - start), int64_t(steps));
+	}
+
+	int64_t position;
+	int64_t delta;
+};
+
+
+#if SIMD_X86
+
+/// Values `i` to `i + 3` of `range`, the same as `range[i]` to `range[i + 3]`.
+/// Values past the end of the range are computed the same way.
+inline __m128 LoadSSE(const Interpolation<float>& range, int i)
+{
+	__m128 index = _mm_add_ps(_mm_set1_ps(float(i)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+	return _mm_add_ps(_mm_set1_ps(range.start()), _mm_mul_ps(_mm_set1_ps(range.step()), index));
+}
+
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Logging that never makes the frame wait on the output: messages are formatted
+// into a fixed ring of slots and written out by a thread of their own.
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+
+enum class LogLevel
+{
+	DEBUG,
+	INFO,
+	WARNING,
+	ERROR,
+};
+
+
+/// A log whose messages are written to `output` by a background thread.
+///
+/// Logging formats the message into a free slot of a bounded queue, claimed with a
+/// compare-and-swap, so any thread can log without taking a lock or waiting on the
+/// output, however slow the terminal or pipe is. If the queue is full, the message
+/// is dropped and counted instead, and the count is written with the next message
+/// that gets through. Messages below `level` are skipped before they're formatted.
+class Log
+{
+public:
+	static const int CAPACITY = 1024;  // Messages. Must be a power of two.
+	static const int LENGTH   = 160;   // Longer messages are cut off.
+
+	explicit Log(LogLevel level = LogLevel::INFO, FILE* output = stdout)
+		: level(level), output(output), slots(new Slot[CAPACITY])
+	{
+		for (int i = 0; i < CAPACITY; ++i)
+			slots[i].sequence.store(size_t(i), std::memory_order_relaxed);
+
+		writer = std::thread([this]() { this->drain(); });
+	}
+
+	~Log()
+	{
+		stopping.store(true, std::memory_order_release);
+		writer.join();
+	}
+
+	Log(const Log&) = delete;
+	Log& operator= (const Log&) = delete;
+
+	bool enabled(LogLevel message_level) const { return message_level >= this->level; }
+
+#if defined(__GNUC__)
+	__attribute__((format(printf, 3, 4)))
+#endif
+	void write(LogLevel message_level, const char* format, ...)
+	{
+		if (!this->enabled(message_level))
+			return;
+
+		size_t position = enqueue_position.load(std::memory_order_relaxed);
+		Slot*  slot;
+		while (true)
+		{
+			slot = &slots[position & (CAPACITY - 1)];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			auto   lag      = std::ptrdiff_t(sequence - position);
+
+			if (lag == 0 && enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+			if (lag < 0)
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			if (lag > 0)
+				position = enqueue_position.load(std::memory_order_relaxed);
+		}
+
+		va_list arguments;
+		va_start(arguments, format);
+		std::vsnprintf(slot->text, LENGTH, format, arguments);
+		va_end(arguments);
+
+		slot->level = message_level;
+		slot->sequence.store(position + 1, std::memory_order_release);
+	}
+
+	/// Waits until every message logged so far has been written.
+	void flush()
+	{
+		size_t target = enqueue_position.load(std::memory_order_acquire);
+		while (written.load(std::memory_order_acquire) < target)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	/// The messages that didn't fit in the queue so far.
+	long long dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;  // `position` when free, `position + 1` when written.
+		LogLevel            level;
+		char                text[LENGTH];
+	};
+
+	static const char* Name(LogLevel level)
+	{
+		switch (level)
+		{
+			case LogLevel::DEBUG:   return "debug";
+			case LogLevel::INFO:    return "info";
+			case LogLevel::WARNING: return "warning";
+			case LogLevel::ERROR:   return "error";
+		}
+		return "";
+	}
+
+	/// Writes how many messages were dropped since the last time it was written, if any.
+	void report_dropped(long long& reported)
+	{
+		long long lost = dropped.load(std::memory_order_relaxed);
+		if (lost != reported)
+			std::fprintf(output, "[warning] %lld messages were dropped\n", lost - reported);
+		reported = lost;
+	}
+
+	/// Writes the messages in order, and sleeps a little whenever the queue is empty.
+	void drain()
+	{
+		long long reported = 0;
+		while (true)
+		{
+			bool stop  = stopping.load(std::memory_order_acquire);
+			int  count = 0;
+
+			for (;; ++count)
+			{
+				Slot& slot = slots[dequeue_position & (CAPACITY - 1)];
+				if (slot.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+					break;
+
+				this->report_dropped(reported);
+				std::fprintf(output, "[%s] %s\n", Name(slot.level), slot.text);
+
+				slot.sequence.store(dequeue_position + CAPACITY, std::memory_order_release);
+				dequeue_position += 1;
+				written.store(dequeue_position, std::memory_order_release);
+			}
+
+			if (count > 0)
+				std::fflush(output);
+			else if (stop)
+			{
+				this->report_dropped(reported);
+				std::fflush(output);
+				return;
+			}
+			else
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	}
+
+	LogLevel level;
+	FILE*    output;
+
+	std::unique_ptr<Slot[]> slots;
+	std::atomic<size_t>     enqueue_position { 0 };
+	size_t                  dequeue_position = 0;  // Only used by the writer.
+	std::atomic<size_t>     written { 0 };
+	std::atomic<long long>  dropped { 0 };
+
+	std::atomic<bool> stopping { false };
+	std::thread       writer;
+};
+
+
+/// Limits something, like a summary line, to once per `interval` seconds of the
+/// time passed to `tick`. Frames in between are counted and their times summed, so
+/// the summary can be about all of them.
+class Periodic
+{
+public:
+	explicit Periodic(double interval) : interval(interval) {}
+
+	/// Adds a frame that took `seconds`. Returns true once `interval` has passed
+	/// since the last time it returned true, after which `frame_count` and `elapsed_time`
+	/// describe the frames since then, until the next call.
+	bool tick(double seconds)
+	{
+		if (this->due)
+		{
+			this->frames  = 0;
+			this->elapsed = 0;
+		}
+
+		this->frames  += 1;
+		this->elapsed += seconds;
+		this->due      = this->elapsed >= this->interval;
+		return this->due;
+	}
+
+	int    frame_count()  const { return this->frames; }
+	double elapsed_time() const { return this->elapsed; }
+	double mean()         const { return this->frames > 0 ? this->elapsed / double(this->frames) : 0; }
+
+private:
+	double interval;
+	int    frames  = 0;
+	double elapsed = 0;
+	bool   due     = false;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Where the time of each frame goes: named, scoped timers for the stages of a
+// frame, a rolling history of frame times, and an optional trace of every timed
+// scope that chrome://tracing (or https://ui.perfetto.dev) can open.
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "Benchmark.h"
+
+
+/// Times the frames of a lab and the stages within them. Stages are timed with a
+/// `Scope`, and the frames with `begin_frame` and `end_frame`:
+///
+///     profiler.begin_frame();
+///     {
+///         Profiler::Scope scope = profiler.scope("geometry");
+///         ...
+///     }
+///     profiler.end_frame();
+///
+/// Only the last `history` frame times are kept, for the percentiles and the
+/// histogram. Stages can be timed on any thread, and are summed over all frames.
+/// With tracing on, every scope is also kept as an event for `save_trace`.
+class Profiler
+{
+public:
+	using Time = std::chrono::steady_clock::time_point;
+
+	/// Records the time from its creation to its destruction as a stage.
+	class Scope
+	{
+	public:
+		Scope(Profiler* profiler, const char* name) : profiler(profiler), name(name), start(Now()) {}
+		~Scope() { if (this->profiler) this->profiler->record(this->name, this->start, Now()); }
+
+		Scope(Scope&& other) : profiler(other.profiler), name(other.name), start(other.start) { other.profiler = nullptr; }
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+
+	private:
+		Profiler*   profiler;
+		const char* name;
+		Time        start;
+	};
+
+	struct Stage
+	{
+		std::string name;
+		int         calls;
+		double      total;  // Seconds.
+	};
+
+	explicit Profiler(int history = 256) : history(std::max(history, 1)), epoch(Now()) {}
+
+	static Time Now() { return std::chrono::steady_clock::now(); }
+
+	/// Keeps every scope from now on as a trace event.
+	void trace(bool enabled) { this->tracing = enabled; }
+
+	/// Times a stage until the returned scope is destroyed. `name` must outlive the profiler.
+	Scope scope(const char* name) { return Scope(this, name); }
+
+	void begin_frame() { this->frame_start = Now(); }
+
+	void end_frame()
+	{
+		Time stop = Now();
+		this->record("frame", this->frame_start, stop);
+		this->add_frame_time(Seconds(stop - this->frame_start));
+	}
+
+	/// Adds a frame time to the history, replacing the oldest one once it is full.
+	void add_frame_time(double seconds)
+	{
+		if (int(this->frame_times.size()) < this->history)
+			this->frame_times.push_back(seconds);
+		else
+			this->frame_times[size_t(this->frames % this->history)] = seconds;
+		this->frames += 1;
+	}
+
+	void record(const char* name, Time start, Time stop)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		// NOTE: Frames are listed with the stages, so every stage can be compared to them.
+		Stage* stage = this->find(name);
+		stage->calls += 1;
+		stage->total += Seconds(stop - start);
+
+		if (this->tracing)
+			this->events.push_back({ name, this->thread_index(), start, stop });
+	}
+
+	/// The frames timed so far, including those no longer in the history.
+	int frame_count() const { return this->frames; }
+
+	/// The nearest-rank percentile of the frame times in the history, in seconds.
+	double percentile(double percent) const
+	{
+		if (this->frame_times.empty())
+			return 0;
+
+		std::vector<double> sorted = this->frame_times;
+		std::sort(sorted.begin(), sorted.end());
+		return Benchmark::Percentile(sorted, percent);
+	}
+
+	/// Counts the frame times in the history per `bucket` seconds. The last of the
+	/// `count` buckets also counts all frames that are slower.
+	std::vector<int> histogram(double bucket, int count) const
+	{
+		std::vector<int> buckets(size_t(std::max(count, 1)), 0);
+		for (double seconds : this->frame_times)
+			buckets[std::min(size_t(seconds / bucket), buckets.size() - 1)] += 1;
+		return buckets;
+	}
+
+	/// The stages in the order they were first timed.
+	std::vector<Stage> stages() const
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return this->stage_list;
+	}
+
+	/// The percentiles of the frame times and the mean time per frame of each stage, as text.
+	std::string report() const
+	{
+		char buffer[256];
+		std::snprintf(buffer, sizeof(buffer), "Frame time over the last %d frames: median %.3f ms, p95 %.3f ms, p99 %.3f ms\n",
+			int(this->frame_times.size()), 1000 * this->percentile(50), 1000 * this->percentile(95), 1000 * this->percentile(99));
+
+		std::string result = buffer;
+		for (const Stage& stage : this->stages())
+		{
+			double per_frame = stage.total / double(std::max(this->frames, 1));
+			std::snprintf(buffer, sizeof(buffer), "  %-16s %9.3f ms per frame, %d calls\n", stage.name.c_str(), 1000 * per_frame, stage.calls);
+			result += buffer;
+		}
+		return result;
+	}
+
+	/// The trace events in the Chrome trace event format, with times in microseconds.
+	std::string trace_json() const
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		std::string result = "{ \"traceEvents\": [\n";
+		char buffer[256];
+		for (size_t i = 0; i < this->events.size(); ++i)
+		{
+			const Event& event = this->events[i];
+			std::snprintf(buffer, sizeof(buffer), "  { \"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f }%s\n",
+				event.name, event.thread, 1e6 * Seconds(event.start - this->epoch), 1e6 * Seconds(event.stop - event.start),
+				i + 1 < this->events.size() ? "," : "");
+			result += buffer;
+		}
+		return result + "] }\n";
+	}
+
+	/// Writes `trace_json()` to `path`. Returns false if the file couldn't be written.
+	bool save_trace(const std::string& path) const
+	{
+		FILE* file = std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+			return false;
+
+		std::string text = this->trace_json();
+		bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+		return std::fclose(file) == 0 && written;
+	}
+
+private:
+	struct Event
+	{
+		const char* name;
+		int         thread;
+		Time        start;
+		Time        stop;
+	};
+
+	static double Seconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	Stage* find(const char* name)
+	{
+		for (Stage& stage : this->stage_list)
+			if (stage.name == name)
+				return &stage;
+
+		this->stage_list.push_back({ name, 0, 0 });
+		return &this->stage_list.back();
+	}
+
+	/// A small number for the calling thread, in the order threads were first seen.
+	int thread_index()
+	{
+		std::thread::id id = std::this_thread::get_id();
+		auto found = std::find(this->threads.begin(), this->threads.end(), id);
+		if (found != this->threads.end())
+			return int(found - this->threads.begin());
+
+		this->threads.push_back(id);
+		return int(this->threads.size()) - 1;
+	}
+
+	int                 history;
+	int                 frames = 0;
+	std::vector<double> frame_times;
+	Time                epoch;
+	Time                frame_start;
+
+	mutable std::mutex           mutex;  // Guards the stages, events and threads.
+	bool                         tracing = false;
+	std::vector<Stage>           stage_list;
+	std::vector<Event>           events;
+	std::vector<std::thread::id> threads;
+};
+
+#endif
@@ -0,0 +1,528 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+// Culling and clipping of triangles, half-space (edge function) rasterization,
+// and binning of triangles into screen tiles so the tiles can be rasterized in parallel.
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+
+/// A vertex after projection, or a fragment of a triangle. `x` and `y` are
+/// in pixels, and `position` is interpolated over the triangle like `z_inv`.
+struct Pixel {
+	int x;
+	int y;
+	float z_inv;
+	glm::vec3 position;
+};
+
+/// A vertex after projection, with its position on the screen not yet rounded
+/// to a pixel. Pixel `(x, y)` is sampled at exactly `screen = (x, y)`.
+struct ScreenVertex {
+	glm::vec2 screen;
+	float z_inv;
+	glm::vec3 position;
+};
+
+/// Vertices are snapped to 1/16 of a pixel.
+const int SUBPIXEL_BITS  = 4;
+const int SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+
+/// Triangles reaching further off the screen than this are clipped (see `ClipTriangle`),
+/// and vertices still past it are clamped, so the edge functions can't overflow.
+const float GUARD_BAND = 16384.0f;
+
+
+/// A vertex snapped to the subpixel grid.
+struct FixedPoint
+{
+	int64_t x;
+	int64_t y;
+
+	static FixedPoint Snap(const glm::vec2& screen)
+	{
+		glm::vec2 clamped = glm::clamp(screen, glm::vec2(-GUARD_BAND), glm::vec2(GUARD_BAND));
+		return { int64_t(glm::round(clamped.x * SUBPIXEL_SCALE)), int64_t(glm::round(clamped.y * SUBPIXEL_SCALE)) };
+	}
+};
+
+
+/// The edge from `a` to `b` as a function `E(x, y)` that is zero on the edge and
+/// positive on the side of it where `c` is, for any triangle `a`, `b`, `c` with
+/// `E(c) > 0`, i.e. one that is wound clockwise on the screen (where y points down).
+///
+/// Pixels exactly on an edge follow the top-left rule: they belong to the
+/// triangle if the edge is a top or a left edge. So a pixel on the edge
+/// shared by two triangles is drawn by exactly one of them.
+struct EdgeFunction
+{
+	int64_t step_x;  // E(x + 1, y) - E(x, y), with `x` in whole pixels.
+	int64_t step_y;  // E(x, y + 1) - E(x, y), with `y` in whole pixels.
+	int64_t origin_x;
+	int64_t origin_y;
+	int64_t bias;    // 0 for top-left edges, -1 for the others, so that `E + bias >= 0` is the inside test.
+
+	static EdgeFunction Create(const FixedPoint& a, const FixedPoint& b)
+	{
+		int64_t dx = b.x - a.x;
+		int64_t dy = b.y - a.y;
+
+		bool is_top_left = (dy == 0 && dx > 0) || dy < 0;
+		return { -dy * SUBPIXEL_SCALE, dx * SUBPIXEL_SCALE, a.x, a.y, is_top_left ? 0 : -1 };
+	}
+
+	/// `E` at the subpixel position `point`.
+	int64_t at(const FixedPoint& point) const
+	{
+		return (step_x * (point.x - origin_x) + step_y * (point.y - origin_y)) / SUBPIXEL_SCALE;
+	}
+
+	/// `E` at the pixel `(x, y)`.
+	int64_t at(int x, int y) const
+	{
+		return this->at(FixedPoint { int64_t(x) * SUBPIXEL_SCALE, int64_t(y) * SUBPIXEL_SCALE });
+	}
+};
+
+
+/// A vertex before the perspective divide: `clip = (x * w, y * w, w)` for the pixel
+/// position `(x, y)` on the screen, where `w` is the distance in front of the camera.
+/// `position` is interpolated over the triangle, like in `ScreenVertex`.
+struct ClipVertex {
+	glm::vec3 clip;
+	glm::vec3 position;
+};
+
+/// Anything nearer to the camera than this is clipped away.
+const float NEAR_PLANE = 0.01f;
+
+/// The most triangles `ClipTriangle` splits a triangle into. It is clipped by at
+/// most five planes, and each one adds at most one vertex to the polygon.
+const int MAX_CLIPPED_TRIANGLES = 6;
+
+
+/// The point at `t` along the line from `a` to `b`. Both `clip` and `position` are
+/// linear in homogeneous space, so they can be interpolated directly.
+inline ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t)
+{
+	return { glm::mix(a.clip, b.clip, t), glm::mix(a.position, b.position, t) };
+}
+
+/// Divides by `w`.
+inline ScreenVertex Project(const ClipVertex& v)
+{
+	return { glm::vec2(v.clip.x, v.clip.y) / v.clip.z, 1.0f / v.clip.z, v.position };
+}
+
+/// Culls and clips the triangle `a`, `b`, `c` for a `width` x `height` screen, and calls
+/// `emit(a, b, c)` with the `ScreenVertex`es of each triangle that is left. Returns the
+/// number of triangles emitted, at most `MAX_CLIPPED_TRIANGLES`.
+///
+/// Triangles entirely behind the near plane or off one side of the screen are culled.
+/// The rest are clipped in homogeneous space, but only against the planes they cross:
+/// the near plane and the sides of the guard band. The guard band is much larger than
+/// the screen, so nearly all triangles reach the rasterizer whole, which cuts them to
+/// the screen for free by only walking the pixels on it.
+template <typename Emit>
+int ClipTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, int width, int height, Emit&& emit)
+{
+	// NOTE: A plane `p` keeps the vertices with `dot(p, (x, y, w, 1)) >= 0`.
+	// The screen planes leave a pixel of margin, so no pixel that a snapped vertex could reach is culled.
+	const glm::vec4 cull_planes[] = {
+		{ 0,  0, 1, -NEAR_PLANE },
+		{ 1,  0, 1, 0 },  // x >= -1
+		{ 0,  1, 1, 0 },  // y >= -1
+		{-1,  0, float(width),  0 },  // x <= width
+		{ 0, -1, float(height), 0 },  // y <= height
+	};
+	const glm::vec4 clip_planes[] = {
+		{ 0,  0, 1, -NEAR_PLANE },
+		{ 1,  0, GUARD_BAND, 0 },
+		{ 0,  1, GUARD_BAND, 0 },
+		{-1,  0, GUARD_BAND, 0 },
+		{ 0, -1, GUARD_BAND, 0 },
+	};
+	auto distance = [](const glm::vec4& plane, const ClipVertex& v) { return glm::dot(plane, glm::vec4(v.clip, 1.0f)); };
+
+	for (const glm::vec4& plane : cull_planes)
+		if (distance(plane, a) < 0 && distance(plane, b) < 0 && distance(plane, c) < 0)
+			return 0;
+
+	bool inside = true;
+	for (const glm::vec4& plane : clip_planes)
+		inside = inside && distance(plane, a) >= 0 && distance(plane, b) >= 0 && distance(plane, c) >= 0;
+
+	if (inside)
+	{
+		emit(Project(a), Project(b), Project(c));
+		return 1;
+	}
+
+	// Sutherland-Hodgman, one plane at a time, between two fixed buffers.
+	const int MAX_VERTICES = MAX_CLIPPED_TRIANGLES + 2;
+	ClipVertex buffers[2][MAX_VERTICES] = { { a, b, c } };
+	int count = 3;
+	int input = 0;
+
+	for (const glm::vec4& plane : clip_planes)
+	{
+		const ClipVertex* in  = buffers[input];
+		ClipVertex*       out = buffers[1 - input];
+
+		bool crossed = false;
+		for (int i = 0; i < count; ++i)
+			crossed = crossed || distance(plane, in[i]) < 0;
+		if (!crossed)
+			continue;
+
+		int kept = 0;
+
+		for (int i = 0; i < count; ++i)
+		{
+			const ClipVertex& current = in[i];
+			const ClipVertex& next    = in[(i + 1) % count];
+			float d_current = distance(plane, current);
+			float d_next    = distance(plane, next);
+
+			if (d_current >= 0)
+				out[kept++] = current;
+			if ((d_current >= 0) != (d_next >= 0))
+				out[kept++] = Lerp(current, next, d_current / (d_current - d_next));
+		}
+
+		count = kept;
+		input = 1 - input;
+		if (count < 3)
+			return 0;
+	}
+
+	const ClipVertex* polygon = buffers[input];
+	ScreenVertex first    = Project(polygon[0]);
+	ScreenVertex previous = Project(polygon[1]);
+	for (int i = 2; i < count; ++i)
+	{
+		ScreenVertex current = Project(polygon[i]);
+		emit(first, previous, current);
+		previous = current;
+	}
+	return count - 2;
+}
+
+
+/// The block size the rasterizer walks the screen in, and the resolution of `HierarchicalDepth`.
+const int RASTER_BLOCK = 8;
+
+
+/// A depth buffer of `z_inv` values (where larger is nearer, and 0 is infinitely far)
+/// for the pixels `[x_min, x_min + width) x [y_min, y_min + height)`, with a coarse
+/// level on top that keeps the farthest depth of each 8x8 block of pixels.
+///
+/// A triangle that is farther away than the farthest depth of a block is hidden in
+/// all of it, so the block can be skipped without reading any per-pixel depth.
+/// `x_min` and `y_min` must be multiples of 8, so the blocks line up with the ones
+/// the rasterizer walks.
+class HierarchicalDepth
+{
+public:
+	void resize(int x_min, int y_min, int width, int height)
+	{
+		this->origin_x = x_min;
+		this->origin_y = y_min;
+		this->width    = width;
+		this->height   = height;
+		this->blocks_x = (width + RASTER_BLOCK - 1) / RASTER_BLOCK;
+
+		depth.resize(size_t(width) * size_t(height));
+		block_farthest.resize(size_t(blocks_x) * size_t((height + RASTER_BLOCK - 1) / RASTER_BLOCK));
+	}
+
+	void clear()
+	{
+		std::fill(depth.begin(), depth.end(), 0.0f);
+		std::fill(block_farthest.begin(), block_farthest.end(), 0.0f);
+	}
+
+	int x_min() const { return origin_x; }
+	int y_min() const { return origin_y; }
+	int x_max() const { return origin_x + width;  }
+	int y_max() const { return origin_y + height; }
+
+	float& at(int x, int y) { return depth[size_t(y - origin_y) * size_t(width) + size_t(x - origin_x)]; }
+
+	/// A lower bound of the depths in the block containing pixel `(x, y)`. Writing to `at`
+	/// only brings pixels nearer, so this stays a lower bound until the block is refreshed.
+	float farthest(int x, int y) const { return block_farthest[block(x, y)]; }
+
+	/// Recomputes `farthest` for the block containing pixel `(x, y)`.
+	void refresh(int x, int y)
+	{
+		int block_x = (x - origin_x) / RASTER_BLOCK * RASTER_BLOCK;
+		int block_y = (y - origin_y) / RASTER_BLOCK * RASTER_BLOCK;
+		int x_end   = std::min(block_x + RASTER_BLOCK, width);
+		int y_end   = std::min(block_y + RASTER_BLOCK, height);
+
+		float result = depth[size_t(block_y) * size_t(width) + size_t(block_x)];
+		for (int j = block_y; j < y_end; ++j)
+			for (int i = block_x; i < x_end; ++i)
+				result = std::min(result, depth[size_t(j) * size_t(width) + size_t(i)]);
+
+		block_farthest[block(x, y)] = result;
+	}
+
+private:
+	size_t block(int x, int y) const
+	{
+		return size_t((y - origin_y) / RASTER_BLOCK) * size_t(blocks_x) + size_t((x - origin_x) / RASTER_BLOCK);
+	}
+
+	int origin_x = 0;
+	int origin_y = 0;
+	int width    = 0;
+	int height   = 0;
+	int blocks_x = 0;
+
+	std::vector<float> depth;
+	std::vector<float> block_farthest;
+};
+
+
+/// Calls `shade(pixel)` for every pixel in `[x_min, x_max) x [y_min, y_max)` that the
+/// triangle `a`, `b`, `c` covers, with `z_inv` and `position` interpolated from the
+/// barycentric coordinates of the pixel. Degenerate triangles cover no pixels.
+///
+/// The bounding box is walked in the 8x8 blocks of the screen that it overlaps. Blocks
+/// outside any edge are skipped, and so are blocks for which `enter_block(x, y)`, with
+/// the top-left pixel of the block, returns false. Once a block is done, `leave_block(x, y)`
+/// is called. Within a block the edge functions are stepped incrementally, so this
+/// allocates nothing and does three integer additions per pixel.
+template <typename EnterBlock, typename Shader, typename LeaveBlock>
+void RasterizeTriangle(ScreenVertex a, ScreenVertex b, ScreenVertex c, int x_min, int y_min, int x_max, int y_max,
+                       EnterBlock&& enter_block, Shader&& shade, LeaveBlock&& leave_block)
+{
+	// NOTE: The vertices are snapped to the subpixel grid, so the edge functions are exact integers.
+	// Both windings are drawn, so a counter-clockwise triangle is made clockwise instead.
+	FixedPoint p0 = FixedPoint::Snap(a.screen);
+	FixedPoint p1 = FixedPoint::Snap(b.screen);
+	FixedPoint p2 = FixedPoint::Snap(c.screen);
+
+	int64_t area = EdgeFunction::Create(p0, p1).at(p2);
+	if (area == 0)
+		return;
+	if (area < 0)
+	{
+		std::swap(b,  c);
+		std::swap(p1, p2);
+		area = -area;
+	}
+
+	// Edge `i` is opposite to vertex `i`, so its value is that vertex's barycentric weight.
+	const EdgeFunction edges[3] = { EdgeFunction::Create(p1, p2), EdgeFunction::Create(p2, p0), EdgeFunction::Create(p0, p1) };
+
+	// The bounding box, rounded inwards to the pixels it contains.
+	auto first_pixel = [](int64_t fixed) { return int((fixed + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS); };
+	auto last_pixel  = [](int64_t fixed) { return int(fixed >> SUBPIXEL_BITS); };
+
+	int left   = std::max(first_pixel(std::min({ p0.x, p1.x, p2.x })),    x_min);
+	int top    = std::max(first_pixel(std::min({ p0.y, p1.y, p2.y })),    y_min);
+	int right  = std::min(last_pixel(std::max({ p0.x, p1.x, p2.x })) + 1, x_max);
+	int bottom = std::min(last_pixel(std::max({ p0.y, p1.y, p2.y })) + 1, y_max);
+	if (left >= right || top >= bottom)
+		return;
+
+	float inverse_area = 1.0f / float(area);
+
+	// NOTE: The blocks are aligned to multiples of 8 on the screen, and cut to the bounding box.
+	for (int block_y = top - top % RASTER_BLOCK; block_y < bottom; block_y += RASTER_BLOCK)
+	{
+		for (int block_x = left - left % RASTER_BLOCK; block_x < right; block_x += RASTER_BLOCK)
+		{
+			int x_begin = std::max(block_x, left);
+			int y_begin = std::max(block_y, top);
+			int x_end   = std::min(block_x + RASTER_BLOCK, right);
+			int y_end   = std::min(block_y + RASTER_BLOCK, bottom);
+
+			// The edge functions are linear, so a block is outside an edge if all its corners are.
+			bool outside = false;
+			for (const EdgeFunction& edge : edges)
+			{
+				int64_t top_corners    = std::max(edge.at(x_begin, y_begin),   edge.at(x_end - 1, y_begin));
+				int64_t bottom_corners = std::max(edge.at(x_begin, y_end - 1), edge.at(x_end - 1, y_end - 1));
+				int64_t corners        = std::max(top_corners, bottom_corners);
+				outside = outside || corners + edge.bias < 0;
+			}
+			if (outside || !enter_block(block_x, block_y))
+				continue;
+
+			int64_t row[3] = { edges[0].at(x_begin, y_begin), edges[1].at(x_begin, y_begin), edges[2].at(x_begin, y_begin) };
+			for (int y = y_begin; y < y_end; ++y)
+			{
+				int64_t w[3] = { row[0], row[1], row[2] };
+				for (int x = x_begin; x < x_end; ++x)
+				{
+					if (w[0] + edges[0].bias >= 0 && w[1] + edges[1].bias >= 0 && w[2] + edges[2].bias >= 0)
+					{
+						float l0 = float(w[0]) * inverse_area;
+						float l1 = float(w[1]) * inverse_area;
+						float l2 = 1.0f - l0 - l1;
+
+						shade(Pixel {
+							x, y,
+							l0 * a.z_inv + l1 * b.z_inv + l2 * c.z_inv,
+							l0 * a.position + l1 * b.position + l2 * c.position
+						});
+					}
+
+					w[0] += edges[0].step_x;
+					w[1] += edges[1].step_x;
+					w[2] += edges[2].step_x;
+				}
+
+				row[0] += edges[0].step_y;
+				row[1] += edges[1].step_y;
+				row[2] += edges[2].step_y;
+			}
+
+			leave_block(block_x, block_y);
+		}
+	}
+}
+
+/// Like above, for every block.
+template <typename Shader>
+void RasterizeTriangle(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c, int x_min, int y_min, int x_max, int y_max, Shader&& shade)
+{
+	RasterizeTriangle(a, b, c, x_min, y_min, x_max, y_max, [](int, int) { return true; }, shade, [](int, int) {});
+}
+
+/// Like above, for the pixels of `depth`, but only calls `shade(pixel)` for the pixels where
+/// the triangle is nearer than `depth` and then writes its depth there.
+///
+/// The triangle's depth is linear on the screen, so it is nowhere nearer than at its nearest
+/// vertex. Blocks where even that is farther than the farthest pixel are skipped as a whole.
+template <typename Shader>
+void RasterizeTriangle(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c, HierarchicalDepth& depth, Shader&& shade)
+{
+	// NOTE: Widened by a few ulps, as the interpolated depth can round to slightly past the vertices'.
+	float nearest = std::max({ a.z_inv, b.z_inv, c.z_inv });
+	nearest += 4.0f * std::numeric_limits<float>::epsilon() * std::abs(nearest);
+	bool  written = false;
+
+	auto enter_block = [&](int x, int y)
+	{
+		written = false;
+		return depth.farthest(x, y) < nearest;
+	};
+
+	auto test_and_shade = [&](const Pixel& pixel)
+	{
+		float& current = depth.at(pixel.x, pixel.y);
+		if (current < pixel.z_inv)
+		{
+			current = pixel.z_inv;
+			written = true;
+			shade(pixel);
+		}
+	};
+
+	auto leave_block = [&](int x, int y)
+	{
+		if (written)
+			depth.refresh(x, y);
+	};
+
+	RasterizeTriangle(a, b, c, depth.x_min(), depth.y_min(), depth.x_max(), depth.y_max(), enter_block, test_and_shade, leave_block);
+}
+
+
+/// Sorts triangles into the square screen tiles their bounding boxes overlap, for
+/// sort-middle rasterization: once every triangle is binned, each tile can be
+/// rasterized on its own, by one thread, from its own list of triangles.
+///
+/// Each tile also owns its own `HierarchicalDepth`, so a thread only ever touches
+/// the depth values of its own tile. The tile size should be a multiple of 8.
+///
+/// The bins keep their memory between frames, so binning only allocates until
+/// the bins have grown to fit the scene.
+class TileBinner
+{
+public:
+	explicit TileBinner(int tile_size = 64) : tile_size(std::max(1, tile_size)) {}
+
+	/// Empties the bins and sizes them for a `width` x `height` frame.
+	void begin_frame(int width, int height)
+	{
+		this->width   = width;
+		this->height  = height;
+		this->tiles_x = (width  + tile_size - 1) / tile_size;
+		this->tiles_y = (height + tile_size - 1) / tile_size;
+
+		bins.resize(size_t(tiles_x) * size_t(tiles_y));
+		for (std::vector<int>& bin : bins)
+			bin.clear();
+
+		depths.resize(bins.size());
+		for (int tile = 0; tile < this->tile_count(); ++tile)
+		{
+			int x_min, y_min, x_max, y_max;
+			this->bounds(tile, x_min, y_min, x_max, y_max);
+			depths[tile].resize(x_min, y_min, x_max - x_min, y_max - y_min);
+		}
+	}
+
+	/// Adds `triangle` to the bin of every tile its bounding box overlaps. Triangles
+	/// must be added in the order they are to be drawn, as each bin keeps that order.
+	void add(int triangle, const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c)
+	{
+		// NOTE: Clamped like `FixedPoint::Snap`, as vertices far off the screen don't fit in an int.
+		glm::vec2 low  = glm::clamp(glm::min(glm::min(a.screen, b.screen), c.screen), glm::vec2(-GUARD_BAND), glm::vec2(GUARD_BAND));
+		glm::vec2 high = glm::clamp(glm::max(glm::max(a.screen, b.screen), c.screen), glm::vec2(-GUARD_BAND), glm::vec2(GUARD_BAND));
+
+		// NOTE: Rounded outwards, so a triangle is never missing from a tile it covers.
+		int left   = std::max(int(std::floor(low.x)),  0);
+		int top    = std::max(int(std::floor(low.y)),  0);
+		int right  = std::min(int(std::ceil(high.x)),  width  - 1);
+		int bottom = std::min(int(std::ceil(high.y)),  height - 1);
+		if (left > right || top > bottom)
+			return;
+
+		for (int tile_y = top / tile_size; tile_y <= bottom / tile_size; ++tile_y)
+			for (int tile_x = left / tile_size; tile_x <= right / tile_size; ++tile_x)
+				bins[tile_y * tiles_x + tile_x].push_back(triangle);
+	}
+
+	int tile_count() const { return tiles_x * tiles_y; }
+
+	/// The pixels `[x_min, x_max) x [y_min, y_max)` of `tile`.
+	void bounds(int tile, int& x_min, int& y_min, int& x_max, int& y_max) const
+	{
+		x_min = (tile % tiles_x) * tile_size;
+		y_min = (tile / tiles_x) * tile_size;
+		x_max = std::min(x_min + tile_size, width);
+		y_max = std::min(y_min + tile_size, height);
+	}
+
+	/// The triangles overlapping `tile`, in the order they were added.
+	const std::vector<int>& triangles(int tile) const { return bins[tile]; }
+
+	/// The depth buffer of `tile`. It isn't cleared by `begin_frame`.
+	HierarchicalDepth& tile_depth(int tile) { return depths[tile]; }
+
+	const int tile_size;
+
+private:
+	int width   = 0;
+	int height  = 0;
+	int tiles_x = 0;
+	int tiles_y = 0;
+
+	std::vector<std::vector<int>>  bins;
+	std::vector<HierarchicalDepth> depths;
+};
+
+#endif
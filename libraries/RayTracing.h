@@ -0,0 +1,675 @@
+#ifndef RAY_TRACING_H
+#define RAY_TRACING_H
+
+// Acceleration structures and ray queries for the ray tracer.
+
+#include <vector>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+#include "TestModel.h"
+#include "TriangleStore.h"
+
+
+const float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+const float ROBUST_EXIT_SCALE = 1.0f + 2.0f * 3.0f * std::numeric_limits<float>::epsilon();
+
+
+/// Axis-aligned bounding box. An empty box has `min > max`.
+struct AABB
+{
+	glm::vec3 min = glm::vec3( std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+	void grow(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void grow(const AABB& box)
+	{
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+
+	/// Half of the surface area. The SAH only compares areas, so the factor 2 is left out.
+	float area() const
+	{
+		if (min.x > max.x)
+			return 0.0f;
+
+		glm::vec3 extent = max - min;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+};
+
+/// Returns the distance along the ray to where it enters `box`, or
+/// `INFINITE_DISTANCE` if it misses the box or enters it after `t_max`.
+inline float IntersectAABB(const AABB& box, const glm::vec3& origin, const glm::vec3& inverse_direction, float t_max)
+{
+	glm::vec3 t0 = (box.min - origin) * inverse_direction;
+	glm::vec3 t1 = (box.max - origin) * inverse_direction;
+	glm::vec3 t_near = glm::min(t0, t1);
+	glm::vec3 t_far  = glm::max(t0, t1);
+
+	// NOTE: The exit distance is scaled up by a few ulps, as rounding could otherwise make rays
+	// miss flat boxes (like axis-aligned walls) around triangles they actually hit.
+	float t_enter = glm::max(glm::max(t_near.x, t_near.y), glm::max(t_near.z, 0.0f));
+	float t_exit  = glm::min(glm::min(t_far.x,  t_far.y),  t_far.z) * ROBUST_EXIT_SCALE;
+	t_exit = glm::min(t_exit, t_max);
+
+	return t_enter <= t_exit ? t_enter : INFINITE_DISTANCE;
+}
+
+
+/// The part of a triangle the intersection kernel reads, precomputed once
+/// so that a test is a handful of dot and cross products.
+struct TriangleRecord
+{
+	glm::vec3 v0;
+	glm::vec3 e1;
+	glm::vec3 e2;
+};
+
+std::vector<TriangleRecord> BuildTriangleRecords(const std::vector<Triangle>& triangles)
+{
+	std::vector<TriangleRecord> records;
+	records.reserve(triangles.size());
+	for (const Triangle& triangle : triangles)
+		records.push_back({ triangle.v0, triangle.v1 - triangle.v0, triangle.v2 - triangle.v0 });
+
+	return records;
+}
+
+/// Solves `origin + t * direction = v0 + u * e1 + v * e2` with Cramer's rule (Möller-Trumbore).
+/// Returns `t` if the ray hits the triangle, i.e. `0 <= t`, `0 <= u`, `0 <= v` and `u + v <= 1`,
+/// and `INFINITE_DISTANCE` otherwise.
+inline float IntersectTriangle(const TriangleRecord& triangle, const glm::vec3& origin, const glm::vec3& direction)
+{
+	glm::vec3 p = glm::cross(direction, triangle.e2);
+	float determinant = glm::dot(triangle.e1, p);
+	if (determinant == 0.0f)
+		return INFINITE_DISTANCE;  // The ray is parallel to the triangle.
+
+	float inverse_determinant = 1.0f / determinant;
+
+	glm::vec3 s = origin - triangle.v0;
+	float u = glm::dot(s, p) * inverse_determinant;
+	if (u < 0.0f || u > 1.0f)
+		return INFINITE_DISTANCE;
+
+	glm::vec3 q = glm::cross(s, triangle.e1);
+	float v = glm::dot(direction, q) * inverse_determinant;
+	if (v < 0.0f || u + v > 1.0f)
+		return INFINITE_DISTANCE;
+
+	float t = glm::dot(triangle.e2, q) * inverse_determinant;
+	return t >= 0.0f ? t : INFINITE_DISTANCE;
+}
+
+
+/// A node is a leaf when `count > 0`, in which case it owns `indices[first .. first + count)`.
+/// Otherwise its children are stored next to each other at `first` and `first + 1`.
+struct BVHNode
+{
+	AABB bounds;
+	int  first;
+	int  count;
+
+	bool is_leaf() const { return count > 0; }
+};
+
+
+/// Bounding volume hierarchy over a list of triangles, built with a binned
+/// surface area heuristic. The triangles themselves are not stored; leaves
+/// refer to them by their index in the list the hierarchy was built from.
+class BVH
+{
+public:
+	std::vector<BVHNode> nodes;
+	std::vector<int>     indices;
+
+	static BVH Build(const std::vector<Triangle>& triangles)
+	{
+		BVH bvh;
+
+		int count = int(triangles.size());
+		if (count == 0)
+			return bvh;
+
+		std::vector<AABB>      boxes(count);
+		std::vector<glm::vec3> centroids(count);
+		for (int i = 0; i < count; ++i)
+		{
+			boxes[i].grow(triangles[i].v0);
+			boxes[i].grow(triangles[i].v1);
+			boxes[i].grow(triangles[i].v2);
+			centroids[i] = (triangles[i].v0 + triangles[i].v1 + triangles[i].v2) / 3.0f;
+		}
+
+		bvh.indices.resize(count);
+		std::iota(bvh.indices.begin(), bvh.indices.end(), 0);
+
+		bvh.nodes.reserve(2 * count - 1);
+		bvh.nodes.push_back({ AABB(), 0, count });
+		bvh.subdivide(0, 0, boxes, centroids);
+
+		return bvh;
+	}
+
+	/// Visits, nearest first, every node the ray enters before `t_max` and calls
+	/// `test(triangle_index, t_max)` for each triangle in the leaves. The test may
+	/// shrink `t_max` when it finds a hit, which prunes the rest of the traversal.
+	template <typename TriangleTest>
+	void traverse(const glm::vec3& origin, const glm::vec3& direction, float& t_max, TriangleTest&& test) const
+	{
+		this->traverse_leaves(origin, direction, t_max, [&](int first, int count, float& t_max) {
+			for (int i = first; i < first + count; ++i)
+				test(indices[i], t_max);
+		});
+	}
+
+	/// Like `traverse`, but calls `test(first, count, t_max)` once per leaf with its
+	/// range in `indices`, so a leaf can be tested as a whole.
+	template <typename LeafTest>
+	void traverse_leaves(const glm::vec3& origin, const glm::vec3& direction, float& t_max, LeafTest&& test) const
+	{
+		if (nodes.empty())
+			return;
+
+		struct Entry { int node; float t_enter; };
+
+		Entry stack[2 * MAX_DEPTH + 2];
+		int   size = 0;
+
+		glm::vec3 inverse_direction = 1.0f / direction;
+
+		float t_root = IntersectAABB(nodes[0].bounds, origin, inverse_direction, t_max);
+		if (t_root == INFINITE_DISTANCE)
+			return;
+
+		stack[size++] = { 0, t_root };
+		while (size > 0)
+		{
+			Entry entry = stack[--size];
+			if (entry.t_enter > t_max)
+				continue;
+
+			const BVHNode& node = nodes[entry.node];
+			if (node.is_leaf())
+			{
+				test(node.first, node.count, t_max);
+				continue;
+			}
+
+			int   near = node.first;
+			int   far  = node.first + 1;
+			float t_near = IntersectAABB(nodes[near].bounds, origin, inverse_direction, t_max);
+			float t_far  = IntersectAABB(nodes[far].bounds,  origin, inverse_direction, t_max);
+			if (t_far < t_near)
+			{
+				std::swap(near,   far);
+				std::swap(t_near, t_far);
+			}
+
+			// Push the far child first so the near child is popped next.
+			if (t_far  != INFINITE_DISTANCE) stack[size++] = { far,  t_far  };
+			if (t_near != INFINITE_DISTANCE) stack[size++] = { near, t_near };
+		}
+	}
+
+	/// Traces the active rays of `packet` together. Each node is fetched once for the whole
+	/// packet and visited if any active ray enters it before its own `t_max[lane]`, and then
+	/// `test(first, count)` is called once per leaf. The test may lower `t_max` when it finds hits.
+	/// Children are visited nearest first along the first active ray, which suits coherent rays.
+	template <typename LeafTest>
+	void traverse_packet(const RayPacket& packet, const float* t_max, LeafTest&& test) const
+	{
+		if (nodes.empty() || packet.active == 0)
+			return;
+
+		glm::vec3 origins[RayPacket::LANES];
+		glm::vec3 inverse_directions[RayPacket::LANES];
+		int       lead = -1;
+		for (int lane = 0; lane < RayPacket::LANES; ++lane)
+		{
+			origins[lane]            = packet.lane_origin(lane);
+			inverse_directions[lane] = 1.0f / packet.lane_direction(lane);
+			if (lead == -1 && packet.is_active(lane))
+				lead = lane;
+		}
+		glm::vec3 lead_direction = packet.lane_direction(lead);
+
+		int stack[MAX_DEPTH + 2];
+		int size = 0;
+
+		stack[size++] = 0;
+		while (size > 0)
+		{
+			const BVHNode& node = nodes[stack[--size]];
+
+			bool entered = false;
+			for (int lane = 0; lane < RayPacket::LANES && !entered; ++lane)
+				entered = packet.is_active(lane) && IntersectAABB(node.bounds, origins[lane], inverse_directions[lane], t_max[lane]) != INFINITE_DISTANCE;
+			if (!entered)
+				continue;
+
+			if (node.is_leaf())
+			{
+				test(node.first, node.count);
+				continue;
+			}
+
+			// NOTE: Comparing the sums of the corners is the same as comparing the centers.
+			int near = node.first;
+			int far  = node.first + 1;
+			glm::vec3 near_center = nodes[near].bounds.min + nodes[near].bounds.max;
+			glm::vec3 far_center  = nodes[far].bounds.min  + nodes[far].bounds.max;
+			if (glm::dot(far_center - near_center, lead_direction) < 0.0f)
+				std::swap(near, far);
+
+			stack[size++] = far;
+			stack[size++] = near;
+		}
+	}
+
+	/// Returns true as soon as `test(triangle_index)` returns true for a triangle in a leaf
+	/// the ray enters before `t_max`. Nodes are visited in no particular order, since any
+	/// hit ends the query.
+	template <typename TriangleTest>
+	bool any_hit(const glm::vec3& origin, const glm::vec3& direction, float t_max, TriangleTest&& test) const
+	{
+		return this->any_hit_leaves(origin, direction, t_max, [&](int first, int count) {
+			for (int i = first; i < first + count; ++i)
+				if (test(indices[i]))
+					return true;
+			return false;
+		});
+	}
+
+	/// Like `any_hit`, but calls `test(first, count)` once per leaf with its range in `indices`.
+	template <typename LeafTest>
+	bool any_hit_leaves(const glm::vec3& origin, const glm::vec3& direction, float t_max, LeafTest&& test) const
+	{
+		if (nodes.empty())
+			return false;
+
+		int stack[MAX_DEPTH + 2];
+		int size = 0;
+
+		glm::vec3 inverse_direction = 1.0f / direction;
+
+		stack[size++] = 0;
+		while (size > 0)
+		{
+			const BVHNode& node = nodes[stack[--size]];
+			if (IntersectAABB(node.bounds, origin, inverse_direction, t_max) == INFINITE_DISTANCE)
+				continue;
+
+			if (node.is_leaf())
+			{
+				if (test(node.first, node.count))
+					return true;
+				continue;
+			}
+
+			stack[size++] = node.first + 1;
+			stack[size++] = node.first;
+		}
+
+		return false;
+	}
+
+private:
+	static const int BINS          = 16;
+	static const int MAX_DEPTH     = 48;
+	static const int MAX_LEAF_SIZE = 8;
+
+	void subdivide(int node_index, int depth, const std::vector<AABB>& boxes, const std::vector<glm::vec3>& centroids)
+	{
+		// NOTE: `nodes` has reserved space for the whole tree, so `node` stays valid while children are added.
+		BVHNode& node = nodes[node_index];
+
+		AABB centroid_bounds;
+		for (int i = node.first; i < node.first + node.count; ++i)
+		{
+			node.bounds.grow(boxes[indices[i]]);
+			centroid_bounds.grow(centroids[indices[i]]);
+		}
+
+		if (node.count == 1 || depth >= MAX_DEPTH)
+			return;
+
+		struct Bin
+		{
+			AABB bounds;
+			int  count = 0;
+		};
+
+		// Cost is measured in triangle tests, with one node traversal costing as much as one test.
+		float best_cost = INFINITE_DISTANCE;
+		int   best_axis = -1;
+		int   best_split = 0;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float low  = centroid_bounds.min[axis];
+			float high = centroid_bounds.max[axis];
+			if (high <= low)
+				continue;
+
+			Bin   bins[BINS];
+			float scale = float(BINS) / (high - low);
+			for (int i = node.first; i < node.first + node.count; ++i)
+			{
+				int b = std::min(BINS - 1, int((centroids[indices[i]][axis] - low) * scale));
+				bins[b].bounds.grow(boxes[indices[i]]);
+				bins[b].count += 1;
+			}
+
+			// Sweep from the right to get the cost of everything to the right of each split...
+			float right_cost[BINS];
+			AABB  right_bounds;
+			int   right_count = 0;
+			for (int b = BINS - 1; b > 0; --b)
+			{
+				right_bounds.grow(bins[b].bounds);
+				right_count += bins[b].count;
+				right_cost[b] = right_bounds.area() * float(right_count);
+			}
+
+			// ... and from the left to combine it with the cost of everything to the left.
+			AABB left_bounds;
+			int  left_count = 0;
+			for (int split = 1; split < BINS; ++split)
+			{
+				left_bounds.grow(bins[split - 1].bounds);
+				left_count += bins[split - 1].count;
+
+				float cost = left_bounds.area() * float(left_count) + right_cost[split];
+				if (left_count > 0 && left_count < node.count && cost < best_cost)
+				{
+					best_cost  = cost;
+					best_axis  = axis;
+					best_split = split;
+				}
+			}
+		}
+
+		if (best_axis == -1)
+			return;  // All centroids coincide, so there is nothing to split.
+
+		float area      = node.bounds.area();
+		float leaf_cost = float(node.count);
+		float split_cost = area > 0.0f ? 1.0f + best_cost / area : 1.0f + float(node.count);
+		if (split_cost >= leaf_cost && node.count <= MAX_LEAF_SIZE)
+			return;
+
+		float low   = centroid_bounds.min[best_axis];
+		float scale = float(BINS) / (centroid_bounds.max[best_axis] - low);
+		auto  middle = std::partition(indices.begin() + node.first, indices.begin() + node.first + node.count, [&](int index) {
+			return std::min(BINS - 1, int((centroids[index][best_axis] - low) * scale)) < best_split;
+		});
+
+		int left_count = int(middle - indices.begin()) - node.first;
+		int left  = int(nodes.size());
+		int right = left + 1;
+
+		nodes.push_back({ AABB(), node.first,              left_count              });
+		nodes.push_back({ AABB(), node.first + left_count, node.count - left_count });
+		node.first = left;
+		node.count = 0;
+
+		subdivide(left,  depth + 1, boxes, centroids);
+		subdivide(right, depth + 1, boxes, centroids);
+	}
+};
+
+
+struct Intersection
+{
+	glm::vec3 position;
+	float     distance;
+	int       triangle_index;
+};
+
+struct Light
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec3 indirect;
+};
+
+
+/// The geometry the ray queries read, built once from a list of triangles.
+/// It is immutable afterwards, and every query borrows it by reference, so
+/// tracing a ray never copies or allocates anything.
+///
+/// The BVH leaves are tested with `kernel` against a structure-of-arrays
+/// copy of the records, stored in the BVH's leaf order.
+class Scene
+{
+public:
+	static Scene Create(std::vector<Triangle> triangles, Kernel kernel = BestKernel())
+	{
+		std::vector<TriangleRecord> records = BuildTriangleRecords(triangles);
+		BVH bvh = BVH::Build(triangles);
+		TriangleStore store = TriangleStore::Create(records, bvh.indices);
+
+		return { std::move(triangles), std::move(records), std::move(bvh), std::move(store), SupportedKernel(kernel) };
+	}
+
+	const std::vector<Triangle>&       triangles() const { return this->triangle_list; }
+	const std::vector<TriangleRecord>& records()   const { return this->record_list; }
+	const BVH&                         bvh()       const { return this->hierarchy; }
+	const TriangleStore&               store()     const { return this->leaf_store; }
+	Kernel                             kernel()    const { return this->leaf_kernel; }
+
+private:
+	Scene(std::vector<Triangle> triangles, std::vector<TriangleRecord> records, BVH bvh, TriangleStore store, Kernel kernel)
+		: triangle_list(std::move(triangles)), record_list(std::move(records)), hierarchy(std::move(bvh)),
+		  leaf_store(std::move(store)), leaf_kernel(kernel) {}
+
+	std::vector<Triangle>       triangle_list;
+	std::vector<TriangleRecord> record_list;
+	BVH                         hierarchy;
+	TriangleStore               leaf_store;
+	Kernel                      leaf_kernel;
+};
+
+
+/// Finds the closest triangle the ray hits. Returns false if it doesn't hit anything.
+inline bool ClosestIntersection(const Scene& scene, glm::vec3 start, glm::vec3 direction, Intersection& closest_intersection)
+{
+	// NOTE: `hit.t` is the traversal's `t_max`, so every hit the leaf tests find prunes the traversal.
+	// Ties are broken by index so the result doesn't depend on the traversal order.
+	LeafHit hit = { std::numeric_limits<float>::max(), -1 };
+
+	scene.bvh().traverse_leaves(start, direction, hit.t, [&](int first, int count, float&)
+	{
+		IntersectLeaf(scene.kernel(), scene.store(), first, count, start, direction, hit);
+	});
+
+	if (hit.triangle_index == -1)
+		return false;
+
+	closest_intersection.position = start + direction * hit.t;
+	closest_intersection.distance = hit.t;
+	closest_intersection.triangle_index = hit.triangle_index;
+	return true;
+}
+
+/// Finds the closest triangle for each active ray of `packet`, exactly like `ClosestIntersection`
+/// does for one ray. Rays that are inactive or don't hit anything get a `triangle_index` of -1.
+inline void ClosestIntersection(const Scene& scene, const RayPacket& packet, Intersection (&closest_intersections)[RayPacket::LANES])
+{
+	PacketHit hit;
+	for (int lane = 0; lane < RayPacket::LANES; ++lane)
+	{
+		hit.t[lane] = std::numeric_limits<float>::max();
+		hit.triangle_index[lane] = -1;
+	}
+
+	scene.bvh().traverse_packet(packet, hit.t, [&](int first, int count)
+	{
+		IntersectPacketLeaf(scene.kernel(), scene.store(), first, count, packet, hit);
+	});
+
+	for (int lane = 0; lane < RayPacket::LANES; ++lane)
+	{
+		Intersection& intersection = closest_intersections[lane];
+		if (hit.triangle_index[lane] == -1)
+		{
+			intersection = { glm::vec3(0), INFINITE_DISTANCE, -1 };
+			continue;
+		}
+
+		intersection.position = packet.lane_origin(lane) + packet.lane_direction(lane) * hit.t[lane];
+		intersection.distance = hit.t[lane];
+		intersection.triangle_index = hit.triangle_index[lane];
+	}
+}
+
+/// Returns true if anything blocks the segment from `origin` to `origin + t_max * direction`,
+/// i.e. if the ray hits a triangle at a distance `t < t_max`. Stops at the first such hit.
+inline bool Occluded(const Scene& scene, const glm::vec3& origin, const glm::vec3& direction, float t_max)
+{
+	return scene.bvh().any_hit_leaves(origin, direction, t_max, [&](int first, int count) {
+		return OccludedLeaf(scene.kernel(), scene.store(), first, count, origin, direction, t_max);
+	});
+}
+
+/// The light arriving directly from `light` at the intersection, reflected by its triangle.
+inline glm::vec3 DirectLight(const Scene& scene, const Light& light, const Intersection& intersection)
+{
+	const Triangle& triangle = scene.triangles()[intersection.triangle_index];
+
+	glm::vec3 rh = light.position - intersection.position;
+	float     r  = glm::length(rh);
+	glm::vec3 n  = glm::normalize(triangle.normal);
+	float     A  = float(4.0 * glm::pi<double>()) * r * r;
+	glm::vec3 B  = light.color / A;
+	glm::vec3 D  = B * glm::max(glm::dot(rh, n), 0.0f);
+
+	// The shadow ray goes from the light towards the point, so anything hit before it reaches
+	// the point casts a shadow. We don't care which triangle is closest, only if there is one.
+	// NOTE: The margin is relative to `r`, as otherwise the point's own triangle is hit due to rounding.
+	if (Occluded(scene, light.position, -rh / r, r * (1.0f - 1e-4f)))
+		return glm::vec3(0);
+
+	return triangle.color * D;
+}
+
+/// The color seen along the ray, clamped to [0, 1].
+inline glm::vec3 Shade(const Scene& scene, const Light& light, glm::vec3 start, glm::vec3 direction)
+{
+	Intersection closest_intersection;
+	if (!ClosestIntersection(scene, start, direction, closest_intersection))
+		return glm::vec3(0);
+
+	const Triangle& triangle = scene.triangles()[closest_intersection.triangle_index];
+
+	glm::vec3 illumination = DirectLight(scene, light, closest_intersection);
+	glm::vec3 R = triangle.color * (illumination + light.indirect);
+	return glm::clamp(R, glm::vec3(0), glm::vec3(1));
+}
+
+/// The colors seen along the active rays of `packet`. The rays are traced together, but
+/// their shadow rays are not coherent, so those are traced one by one.
+inline void Shade(const Scene& scene, const Light& light, const RayPacket& packet, glm::vec3 (&colors)[RayPacket::LANES])
+{
+	Intersection closest_intersections[RayPacket::LANES];
+	ClosestIntersection(scene, packet, closest_intersections);
+
+	for (int lane = 0; lane < RayPacket::LANES; ++lane)
+	{
+		const Intersection& closest_intersection = closest_intersections[lane];
+		if (closest_intersection.triangle_index == -1)
+		{
+			colors[lane] = glm::vec3(0);
+			continue;
+		}
+
+		const Triangle& triangle = scene.triangles()[closest_intersection.triangle_index];
+
+		glm::vec3 illumination = DirectLight(scene, light, closest_intersection);
+		glm::vec3 R = triangle.color * (illumination + light.indirect);
+		colors[lane] = glm::clamp(R, glm::vec3(0), glm::vec3(1));
+	}
+}
+
+
+/// How `ShadeTile` traces the primary rays: one at a time, or as 2x2 packets of neighbouring pixels.
+enum class TraceMode
+{
+	SINGLE,
+	PACKET,
+};
+
+/// The primary rays of a `width` x `height` image, one through each pixel, seen from
+/// `position` with the axes of the camera and its focal length.
+struct PrimaryRays
+{
+	glm::vec3 position;
+	glm::vec3 right;
+	glm::vec3 up;
+	glm::vec3 forward;
+	float     focal_length;
+	int       width;
+	int       height;
+
+	glm::vec3 direction(int x, int y) const
+	{
+		auto W = float(width);
+		auto H = float(height);
+
+		float u = 2.0f * (float(x) / W) - 1.0f;  // Normalized between [-1, 1]
+		float v = 2.0f * (float(y) / H) - 1.0f;  // Normalized between [-1, 1]
+
+		return right * u * (W / 2.0f) + up * v * (H / 2.0f) + forward * focal_length;
+	}
+};
+
+/// Traces the pixels `[x_min, x_max) x [y_min, y_max)` of `rays` and writes their colors to
+/// `colors`, which holds `rays.width` colors per row. Nothing is allocated, and every pixel
+/// only depends on the scene and the ray, so tiles can be traced in any order, on any thread.
+inline void ShadeTile(const Scene& scene, const Light& light, const PrimaryRays& rays, TraceMode mode,
+                      int x_min, int y_min, int x_max, int y_max, glm::vec3* colors)
+{
+	auto width = size_t(rays.width);
+
+	if (mode == TraceMode::SINGLE)
+	{
+		for (int y = y_min; y < y_max; ++y)
+			for (int x = x_min; x < x_max; ++x)
+				colors[size_t(y) * width + size_t(x)] = Shade(scene, light, rays.position, rays.direction(x, y));
+		return;
+	}
+
+	// Lane `i` of a packet is the pixel `(x + i % 2, y + i / 2)`. Pixels outside
+	// the tile, at its right and bottom edges, are left out of the packet.
+	for (int y = y_min; y < y_max; y += 2)
+	{
+		for (int x = x_min; x < x_max; x += 2)
+		{
+			RayPacket packet;
+			for (int lane = 0; lane < RayPacket::LANES; ++lane)
+				if (x + lane % 2 < x_max && y + lane / 2 < y_max)
+					packet.set(lane, rays.position, rays.direction(x + lane % 2, y + lane / 2));
+
+			glm::vec3 lane_colors[RayPacket::LANES];
+			Shade(scene, light, packet, lane_colors);
+
+			for (int lane = 0; lane < RayPacket::LANES; ++lane)
+				if (packet.is_active(lane))
+					colors[size_t(y + lane / 2) * width + size_t(x + lane % 2)] = lane_colors[lane];
+		}
+	}
+}
+
+#endif
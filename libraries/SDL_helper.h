@@ -1,11 +1,21 @@
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #define SDL_MAIN_HANDLED
 #include "SDL.h"
 #include "glm/glm.hpp"
 #include "debug.c"
+#include "ColorConversion.h"
 
 #ifndef SCREENSHOT_PATH
 	#define SCREENSHOT_PATH "screenshots"
@@ -45,33 +55,324 @@ Uint32 ColorCode(const glm::vec3& color)
 }
 
 
+/// A view of a window's pixels for inner loops, with the size looked up once.
+/// Writes through it are only bounds checked in debug builds (without `NDEBUG`),
+/// so a release build writes each pixel with a single store.
+struct Framebuffer
+{
+	Uint32* pixels;
+	int     width;
+	int     height;
+	int     stride;  // Pixels from the start of one row to the next.
+
+	Uint32* row(int y) const { return this->pixels + size_t(y) * size_t(this->stride); }
+
+	void set_pixel(int x, int y, const glm::vec3& color) const
+	{
+		this->check(x, y, 1, 1);
+		this->row(y)[x] = ColorCode(color);
+	}
+
+	/// Writes `count` already encoded pixels to row `y`, from `x` on.
+	void write_row(int x, int y, const Uint32* codes, int count) const
+	{
+		this->check(x, y, count, 1);
+		std::memcpy(this->row(y) + x, codes, size_t(count) * sizeof(Uint32));
+	}
+
+	/// Writes `count` colors to row `y`, from `x` on, converted with `ConvertToARGB`
+	/// (so channels outside [0, 1] are clamped), and through `gamma` if it's given.
+	void write_row(int x, int y, const glm::vec3* colors, int count, const GammaTable* gamma = nullptr) const
+	{
+		this->check(x, y, count, 1);
+		ConvertToARGB(colors, this->row(y) + x, count, gamma);
+	}
+
+	/// Copies the `width` x `height` colors in `colors`, stored row by row, to the pixels from `(x, y)` on.
+	void blit(int x, int y, const glm::vec3* colors, int width, int height, const GammaTable* gamma = nullptr) const
+	{
+		this->check(x, y, width, height);
+		if (x == 0 && width == this->width && width == this->stride)
+		{
+			// NOTE: Whole rows are contiguous, so the block is converted in one pass.
+			ConvertToARGB(colors, this->row(y), width * height, gamma);
+			return;
+		}
+
+		for (int j = 0; j < height; ++j)
+			this->write_row(x, y + j, colors + size_t(j) * size_t(width), width, gamma);
+	}
+
+	/// Fills the pixels `[x_min, x_max) x [y_min, y_max)` with `color`.
+	void fill(int x_min, int y_min, int x_max, int y_max, const glm::vec3& color) const
+	{
+		this->check(x_min, y_min, x_max - x_min, y_max - y_min);
+		Uint32 color_code = ColorCode(color);
+		for (int y = y_min; y < y_max; ++y)
+			std::fill(this->row(y) + x_min, this->row(y) + x_max, color_code);
+	}
+
+	void fill(const glm::vec3& color) const { this->fill(0, 0, this->width, this->height, color); }
+
+private:
+	void check(int x, int y, int width, int height) const
+	{
+#ifndef NDEBUG
+		Assert(0 <= x && x + width  <= this->width,  "x must be between 0 and %i, got %i to %i", this->width,  x, x + width);
+		Assert(0 <= y && y + height <= this->height, "y must be between 0 and %i, got %i to %i", this->height, y, y + height);
+#else
+		(void) x; (void) y; (void) width; (void) height;
+#endif
+	}
+};
+
+
+/// Measures the time between frames with the performance counter, which resolves
+/// far less than a millisecond, so even the fastest frames don't read as 0.
 struct Clock
 {
 public:
-	Clock() : current_tick(SDL_GetTicks()), last_tick(current_tick) {}
+	Clock() : current_tick(SDL_GetPerformanceCounter()), last_tick(current_tick) {}
 
 	/// Returns the time, in seconds, since last call to `tick`.
 	float tick()
 	{
 		this->last_tick    = this->current_tick;
-		this->current_tick = SDL_GetTicks();
+		this->current_tick = SDL_GetPerformanceCounter();
 
-		unsigned delta = this->current_tick - this->last_tick;
-		return delta / 1000.0f;
+		Uint64 delta = this->current_tick - this->last_tick;
+		return float(double(delta) / double(SDL_GetPerformanceFrequency()));
 	}
 
 private:
-	unsigned current_tick;
-	unsigned last_tick;
+	Uint64 current_tick;
+	Uint64 last_tick;
 };
 
 
 
+/// How a window gets its pixels to the screen.
+enum class Presentation
+{
+	COPY,       // Draw to our own array, which `update` uploads to the texture.
+	STREAMING,  // Draw straight into the texture's memory, from `SDL_LockTexture`.
+	ASYNC,      // Draw to one of three arrays on another thread, while this one shows the last one finished.
+};
+
+
+/// Command-line options shared by all labs:
+///
+///     [--frames N] [--width W] [--height H] [--out FILE] [--benchmark FILE] [--present copy|streaming|async]
+///     [--profile FILE]
+///
+/// Giving `--frames` renders that many frames offscreen, without ever opening a
+/// window, and then exits, which is what batch jobs without a display need.
+/// The last frame is written to `--out` as a BMP if it's given. `--benchmark`
+/// does the same (for 60 frames by default) but follows a scripted path instead
+/// of the keyboard, and writes the frame times as JSON to its file. `--present` picks
+/// the `Presentation` of a window on the screen. `--profile` writes where the time of
+/// each frame went to its file, as a Chrome trace (see `Profiler`). Flags that aren't recognized are
+/// skipped, so a lab can parse its own flags from the same arguments.
+struct RenderOptions
+{
+	int          frames = 0;  // 0 means run interactively until the window is closed.
+	int          width;
+	int          height;
+	std::string  out;
+	std::string  benchmark;
+	Presentation presentation = Presentation::STREAMING;
+	std::string  profile;
+
+	bool headless()     const { return this->frames > 0; }
+	bool benchmarking() const { return !this->benchmark.empty(); }
+	bool profiling()    const { return !this->profile.empty(); }
+
+	static RenderOptions Parse(int argc, char* argv[], int default_width, int default_height)
+	{
+		RenderOptions options = { 0, default_width, default_height, "", "", Presentation::STREAMING, "" };
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			std::string flag  = argv[i];
+			std::string value = argv[i + 1];
+			if      (flag == "--frames")    options.frames    = std::atoi(value.c_str());
+			else if (flag == "--width")     options.width     = std::atoi(value.c_str());
+			else if (flag == "--height")    options.height    = std::atoi(value.c_str());
+			else if (flag == "--out")       options.out       = value;
+			else if (flag == "--benchmark") options.benchmark = value;
+			else if (flag == "--profile")   options.profile   = value;
+			else if (flag == "--present")   options.presentation = value == "copy" ? Presentation::COPY : value == "async" ? Presentation::ASYNC : Presentation::STREAMING;
+		}
+
+		if (options.benchmarking() && options.frames == 0)
+			options.frames = 60;
+
+		Assert(options.frames >= 0, "--frames must not be negative, got %i", options.frames);
+		Assert(options.width > 0 && options.height > 0, "Size must be positive, got %i x %i", options.width, options.height);
+		return options;
+	}
+};
+
+
+/// Overlaps drawing a frame with presenting the one before it. SDL's video functions
+/// must stay on the main thread: the event pump updates the renderer while it runs,
+/// and some platforms only allow the window to be updated from the main thread. So it's
+/// the drawing that moves instead: `render` runs the drawing on a thread of its own,
+/// while the calling (main) thread uploads and presents the newest finished frame.
+///
+/// The frames are triple buffered: the drawing thread owns the back buffer and the
+/// main thread the front buffer, and the newest finished frame is in between. Each
+/// side swaps its buffer with the one in between with an atomic exchange, so neither
+/// ever waits for the other. Frames finished faster than they can be presented replace
+/// each other, and only the newest is shown. A frame is shown during the next `render`,
+/// i.e. one frame later than without this.
+class AsyncPresenter
+{
+public:
+	AsyncPresenter(SDL_Renderer* renderer, SDL_Texture* texture, int width, int height)
+		: renderer(renderer), texture(texture), width(width)
+	{
+		for (std::vector<Uint32>& buffer : buffers)
+			buffer.resize(size_t(width) * size_t(height));
+
+		thread = std::thread([this]() { this->run(); });
+	}
+
+	~AsyncPresenter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+	}
+
+	AsyncPresenter(const AsyncPresenter&) = delete;
+	AsyncPresenter& operator= (const AsyncPresenter&) = delete;
+
+	/// Calls `draw` on the drawing thread, and presents the newest finished frame on this
+	/// thread in the meantime. Returns once `draw` is done. Must be called from the main
+	/// thread, one frame at a time.
+	void render(const std::function<void()>& draw)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &draw;
+		}
+		wake.notify_one();
+
+		this->present_newest();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return job == nullptr; });
+	}
+
+	/// The buffer to draw the next frame to. It holds an old frame.
+	Uint32* back() { return buffers[back_index].data(); }
+
+	/// The last frame that was published. Only valid between calls to `render`.
+	const Uint32* newest() const { return buffers[newest_index].data(); }
+
+	/// Hands the back buffer over to be presented, and takes another one to draw to.
+	void publish()
+	{
+		newest_index = back_index;
+		back_index   = middle.exchange(back_index | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+private:
+	static const int INDEX = 3;
+	static const int FRESH = 4;  // Set while the buffer in between hasn't been presented.
+
+	/// Swaps the front buffer for the one in between and shows it, unless it was shown already.
+	void present_newest()
+	{
+		if ((middle.load(std::memory_order_acquire) & FRESH) == 0)
+			return;
+
+		// NOTE: Only this thread clears `FRESH`, so the buffer in between is still fresh,
+		//       or an even newer frame.
+		front_index = middle.exchange(front_index, std::memory_order_acq_rel) & INDEX;
+
+		Assert(SDL_UpdateTexture(texture, nullptr, buffers[front_index].data(), width * 4) == 0, "Error: %s", SDL_GetError());
+		Assert(SDL_RenderCopy(renderer, texture, nullptr, nullptr) == 0, "Error: %s", SDL_GetError());
+		SDL_RenderPresent(renderer);
+	}
+
+	/// Runs each `draw` handed to `render` on the drawing thread.
+	void run()
+	{
+		while (true)
+		{
+			const std::function<void()>* draw;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || job != nullptr; });
+				if (stopping)
+					return;
+				draw = job;
+			}
+
+			(*draw)();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				job = nullptr;
+			}
+			done.notify_one();
+		}
+	}
 
+	SDL_Renderer* renderer;
+	SDL_Texture*  texture;
+	int           width;
+
+	std::vector<Uint32> buffers[3];
+	int                 back_index   = 0;  // Only used by the drawing thread, like `newest_index`.
+	int                 newest_index = 0;
+	int                 front_index  = 2;  // Only used by the main thread.
+	std::atomic<int>    middle { 1 };
+
+	std::mutex                   mutex;
+	std::condition_variable      wake;
+	std::condition_variable      done;
+	const std::function<void()>* job      = nullptr;  // Set while the drawing thread has a frame to draw.
+	bool                         stopping = false;
+	std::thread                  thread;
+};
+
+
+/// The pixels the labs draw to. A window shows them on the screen, while a
+/// headless one only keeps them in memory and never touches the video subsystem.
+///
+/// With `Presentation::STREAMING`, the pixels are the memory of the locked texture,
+/// so nothing is copied before it's shown. That memory is only valid until `update`,
+/// and doesn't keep the last frame, so every frame must write every pixel, and must
+/// get the pixels through `framebuffer` again after each `update`. The same goes for
+/// `Presentation::ASYNC`, where `update` hands the frame to an `AsyncPresenter` and
+/// returns at once. Frames are only drawn on another thread, and overlapped with
+/// presenting, when they're drawn through `render`.
 class Window
 {
 public:
-	static Window Create(const std::string& name, int width, int height)
+	/// Opens a headless window if `options` asks for it, and a regular one otherwise.
+	static Window Create(const std::string& name, const RenderOptions& options)
+	{
+		if (options.headless())
+			return CreateHeadless(options.width, options.height);
+		return Create(name, options.width, options.height, options.presentation);
+	}
+
+	static Window CreateHeadless(int width, int height)
+	{
+		// NOTE: Only the timer is needed (for `Clock`), so this works without a display.
+		Assert(SDL_Init(SDL_INIT_TIMER) == 0, "Couldn't initialize SDL. %s", SDL_GetError());
+
+		Uint32* pixels = new Uint32[size_t(width) * size_t(height)];
+		return { nullptr, nullptr, nullptr, nullptr, Presentation::COPY, pixels, width, height };
+	}
+
+	static Window Create(const std::string& name, int width, int height, Presentation presentation = Presentation::STREAMING)
 	{
 		Assert(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) == 0, "Couldn't initialize SDL. %s", SDL_GetError());
 
@@ -80,82 +381,122 @@ public:
 
 		SDL_Window*   window   = SDL_CreateWindow(name.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, window_flags);
 		SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, renderer_flags);
-		SDL_Texture*  screen   = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
 
 		Assert(window,   "Couldn't create window. %s",   SDL_GetError());
 		Assert(renderer, "Couldn't create renderer. %s", SDL_GetError());
-		Assert(screen,   "Couldn't create texture. %s",  SDL_GetError());
 
+		// NOTE: The texture has the size of the output, which can be larger than the window on high-DPI screens.
 		int w, h;
 		SDL_GetRendererOutputSize(renderer, &w, &h);
-		Uint32* pixels = new Uint32[size_t(w) * size_t(h)];
+		SDL_Texture* screen = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+		Assert(screen, "Couldn't create texture. %s", SDL_GetError());
 
-		return { window, renderer, screen, pixels };
+		Uint32*        pixels    = presentation == Presentation::COPY  ? new Uint32[size_t(w) * size_t(h)] : nullptr;
+		AsyncPresenter* presenter = presentation == Presentation::ASYNC ? new AsyncPresenter(renderer, screen, w, h) : nullptr;
+		return { window, renderer, screen, presenter, presentation, pixels, w, h };
 	}
 
 	static void Destroy(Window* window) {
-		delete[] window->pixels;
-		SDL_DestroyTexture(window->screen);
-		SDL_DestroyRenderer(window->renderer);
-		SDL_DestroyWindow(window->handle);
+		if (window->presentation == Presentation::COPY)
+			delete[] window->pixels;
+		if (!window->is_headless())
+		{
+			delete window->presenter;
+			window->unlock();
+			SDL_DestroyTexture(window->screen);
+			SDL_DestroyRenderer(window->renderer);
+			SDL_DestroyWindow(window->handle);
+		}
 
 		window = nullptr;
 	}
 
-	void set_pixel(int x, int y, const glm::vec3& color)
+	int  width()       const { return this->pixel_width;  }
+	int  height()      const { return this->pixel_height; }
+	bool is_headless() const { return this->handle == nullptr; }
+
+	/// The pixels, for drawing many of them. The view stays valid until `update`, or for as
+	/// long as the window without `Presentation::STREAMING`.
+	Framebuffer framebuffer()
 	{
-		int width, height;
-		SDL_GetRendererOutputSize(this->renderer, &width, &height);
+		if (this->presentation == Presentation::STREAMING && this->pixels == nullptr)
+			this->lock();
+		if (this->presentation == Presentation::ASYNC)
+			this->pixels = this->presenter->back();
+		return { this->pixels, this->pixel_width, this->pixel_height, this->pixel_stride };
+	}
 
-		Assert(0 <= x && x < width,  "x must be between 0 and %i, got %i", width,  x);
-		Assert(0 <= y && y < height, "y must be between 0 and %i, got %i", height, y);
+	void set_pixel(int x, int y, const glm::vec3& color) { this->framebuffer().set_pixel(x, y, color); }
+	void fill(const glm::vec3& color)                     { this->framebuffer().fill(color); }
 
-		this->pixels[y * width + x] = ColorCode(color);
+	/// Converts a whole frame of `width() * height()` colors, stored row by row, to the pixels
+	/// in one pass (see `Framebuffer::blit`), and shows them like `update`.
+	void present(const glm::vec3* colors, const GammaTable* gamma = nullptr)
+	{
+		this->framebuffer().blit(0, 0, colors, this->pixel_width, this->pixel_height, gamma);
+		this->update();
 	}
 
-	void fill(const glm::vec3& color)
+	/// Calls `draw`, which draws a frame and ends it with `update` or `present`. With
+	/// `Presentation::ASYNC`, it's called on a thread of its own while this thread shows
+	/// the frame before it. Otherwise it's simply called. Either way, SDL is only ever
+	/// used from this thread, so `draw` must not handle events or use SDL itself.
+	void render(const std::function<void()>& draw)
 	{
-		Uint8 r = MapFloatToUint8(color.r);
-		Uint8 g = MapFloatToUint8(color.g);
-		Uint8 b = MapFloatToUint8(color.b);
-		
-		Assert(SDL_SetRenderDrawColor(this->renderer, r, g, b, 255) == 0, "Error: %s", SDL_GetError());
-		Assert(SDL_RenderClear(this->renderer) == 0, "Error: %s", SDL_GetError());
-
-		int width, height;
-		SDL_GetRendererOutputSize(this->renderer, &width, &height);
-
-		Uint32 color_code = ColorCode(color);
-		for (int y = 0; y < height; ++y)
-			for (int x = 0; x < width; ++x)
-				this->pixels[y * width + x] = color_code;
-
-		Assert(SDL_UpdateTexture(this->screen, nullptr, this->pixels, width * sizeof(Uint32)) == 0, "Error: %s", SDL_GetError());
+		if (this->presentation == Presentation::ASYNC)
+			this->presenter->render(draw);
+		else
+			draw();
 	}
 
+	/// Shows the pixels on the screen. Does nothing for a headless window.
 	void update() 
 	{
-		int width, height;
-		SDL_GetRendererOutputSize(this->renderer, &width, &height);
+		if (this->is_headless())
+			return;
 
-		Assert(SDL_UpdateTexture(this->screen, nullptr, &this->pixels[0], width * 4) == 0, "Error: %s", SDL_GetError());
+		if (this->presentation == Presentation::ASYNC)
+		{
+			this->presenter->publish();
+			return;
+		}
+
+		if (this->presentation == Presentation::STREAMING)
+			this->unlock();
+		else
+			Assert(SDL_UpdateTexture(this->screen, nullptr, &this->pixels[0], this->pixel_width * 4) == 0, "Error: %s", SDL_GetError());
 
 		Assert(SDL_RenderCopy(this->renderer, this->screen, nullptr, nullptr) == 0, "Error: %s", SDL_GetError());
 		SDL_RenderPresent(this->renderer);
 	}
 
-	void screenshot(const std::string& filename)
+	/// Writes the pixels as a BMP to `path`.
+	void save(const std::string& path)
 	{
-		int width, height;
-		SDL_GetRendererOutputSize(this->renderer, &width, &height);
-
-		std::string full_path = SCREENSHOT_PATH + filename;
-
-		SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(this->pixels, width, height, 32, width * 4, 0, 0, 0, 0);
-		Assert(SDL_SaveBMP(surface, full_path.c_str()) == 0, "Error: %s", SDL_GetError());
+		if (this->presentation != Presentation::STREAMING)
+		{
+			// NOTE: An async window saves the last frame that was drawn, like the other windows.
+			Uint32* pixels = this->presentation == Presentation::ASYNC ? const_cast<Uint32*>(this->presenter->newest()) : this->pixels;
+			SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(pixels, this->pixel_width, this->pixel_height, 32, this->pixel_width * 4, 0, 0, 0, 0);
+			Assert(SDL_SaveBMP(surface, path.c_str()) == 0, "Error: %s", SDL_GetError());
+			SDL_FreeSurface(surface);
+			return;
+		}
+
+		// NOTE: Locked texture memory can't be read back, so the texture is drawn and read from the renderer instead.
+		this->unlock();
+		SDL_Surface* surface = SDL_CreateRGBSurface(0, this->pixel_width, this->pixel_height, 32, 0, 0, 0, 0);
+		Assert(SDL_RenderCopy(this->renderer, this->screen, nullptr, nullptr) == 0, "Error: %s", SDL_GetError());
+		Assert(SDL_RenderReadPixels(this->renderer, nullptr, surface->format->format, surface->pixels, surface->pitch) == 0, "Error: %s", SDL_GetError());
+		Assert(SDL_SaveBMP(surface, path.c_str()) == 0, "Error: %s", SDL_GetError());
 		SDL_FreeSurface(surface);
 	}
 
+	void screenshot(const std::string& filename)
+	{
+		this->save(SCREENSHOT_PATH + filename);
+	}
+
 	void screenshot()
 	{
 		using namespace std;
@@ -175,13 +516,38 @@ public:
 
 
 private:
-	Window(SDL_Window* handle, SDL_Renderer* renderer, SDL_Texture* screen, Uint32* pixels) 
-		: handle(handle), renderer(renderer), screen(screen), pixels(pixels) {}
+	Window(SDL_Window* handle, SDL_Renderer* renderer, SDL_Texture* screen, AsyncPresenter* presenter, Presentation presentation, Uint32* pixels, int width, int height) 
+		: handle(handle), renderer(renderer), screen(screen), presenter(presenter), presentation(presentation), pixels(pixels), pixel_width(width), pixel_height(height), pixel_stride(width) {}
 
-	SDL_Window*   handle;
-	SDL_Renderer* renderer;
-	SDL_Texture*  screen;
-	Uint32*       pixels;
+	void lock()
+	{
+		void* memory;
+		int   pitch;
+		Assert(SDL_LockTexture(this->screen, nullptr, &memory, &pitch) == 0, "Error: %s", SDL_GetError());
+
+		this->pixels       = static_cast<Uint32*>(memory);
+		this->pixel_stride = pitch / int(sizeof(Uint32));
+	}
+
+	/// Hands the pixels drawn since `lock` to the texture. Does nothing if it isn't locked.
+	void unlock()
+	{
+		if (this->presentation != Presentation::STREAMING || this->pixels == nullptr)
+			return;
+
+		SDL_UnlockTexture(this->screen);
+		this->pixels = nullptr;
+	}
+
+	SDL_Window*     handle;
+	SDL_Renderer*   renderer;
+	SDL_Texture*    screen;
+	AsyncPresenter* presenter;  // Only for `Presentation::ASYNC`.
+	Presentation    presentation;
+	Uint32*         pixels;  // Null while a streaming texture isn't locked.
+	int             pixel_width;
+	int             pixel_height;
+	int             pixel_stride;
 };
 
 
@@ -0,0 +1,144 @@
+#ifndef SCANLINE_H
+#define SCANLINE_H
+
+// Scanline rasterization of convex polygons: the polygon is cut into rows, and each row
+// is filled from its leftmost to its rightmost pixel. Everything lives in an `Arena`.
+
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "Rasterizer.h"
+#include "Interpolation.h"
+#include "Arena.h"
+
+
+/// The pixels of a line, made as they're iterated. `x` and `y` are stepped exactly with
+/// a `Dda`, so the line hits every row or column between its ends, whichever there are
+/// more of, exactly once. `z_inv` and the position are interpolated alongside.
+struct PixelLine
+{
+	/// Steps through the pixels with integer adds, instead of computing each one.
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = Pixel;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = void;
+		using reference         = Pixel;
+
+		Iterator(const PixelLine* line, int index)
+			: line(line), index(index), x(line->x0, line->x1, line->steps), y(line->y0, line->y1, line->steps) {}
+
+		Pixel operator*() const { return Pixel { x.value(), y.value(), line->z_inv[index], line->position[index] }; }
+
+		Iterator& operator++() { ++index; x.next(); y.next(); return *this; }
+
+		bool operator==(const Iterator& other) const { return index == other.index; }
+		bool operator!=(const Iterator& other) const { return index != other.index; }
+
+	private:
+		const PixelLine* line;
+		int              index;
+		Dda              x;
+		Dda              y;
+	};
+
+	int x0, y0;
+	int x1, y1;
+	int steps;
+	Interpolation<float>     z_inv;
+	Interpolation<glm::vec3> position;
+
+	Pixel operator[](int i) const
+	{
+		return Pixel { Dda::At(x0, x1, steps, i), Dda::At(y0, y1, steps, i), z_inv[i], position[i] };
+	}
+
+	int size() const { return z_inv.size(); }
+
+	Iterator begin() const { return Iterator(this, 0); }
+	Iterator end()   const { return Iterator(this, this->size()); }
+};
+
+/// The pixels from `a` to `b`, one per row or column, whichever there are more of.
+/// Nothing is allocated; the pixels are made as the line is iterated.
+inline PixelLine Interpolate(Pixel a, Pixel b)
+{
+	int pixels = std::max(std::abs(b.x - a.x), std::abs(b.y - a.y)) + 1;
+
+	return PixelLine {
+		a.x, a.y,
+		b.x, b.y,
+		std::max(pixels - 1, 1),
+		Interpolation<float>::Between(a.z_inv, b.z_inv, pixels),
+		Interpolation<glm::vec3>::Between(a.position, b.position, pixels)
+	};
+}
+
+/// The leftmost and rightmost pixel of each row of the convex polygon, in `arena`.
+inline std::tuple<ArenaVector<Pixel>, ArenaVector<Pixel>> ComputePolygonRows(Arena& arena, const ArenaVector<Pixel>& vertices)
+{
+	const int count = int(vertices.size());
+
+	int top    = vertices[0].y;
+	int bottom = vertices[0].y;
+	for (int i = 1; i < count; ++i)
+	{
+		top    = std::min(top,    vertices[i].y);
+		bottom = std::max(bottom, vertices[i].y);
+	}
+
+	const int rows = bottom - top + 1;
+
+	ArenaVector<Pixel> left(rows,  Pixel(), ArenaAllocator<Pixel>(arena));
+	ArenaVector<Pixel> right(rows, Pixel(), ArenaAllocator<Pixel>(arena));
+
+	for (int row = 0; row < rows; ++row)
+	{
+		left[row].x  = std::numeric_limits<int>::max();
+		right[row].x = std::numeric_limits<int>::min();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		for (const Pixel& pixel : Interpolate(vertices[i], vertices[(i + 1) % count]))
+		{
+			Pixel& a = left[pixel.y - top];
+			Pixel& b = right[pixel.y - top];
+
+			if (a.x > pixel.x) { a = pixel; }
+			if (b.x < pixel.x) { b = pixel; }
+		}
+	}
+
+	return { std::move(left), std::move(right) };
+}
+
+/// The pixels of the convex polygon, in `arena`.
+inline ArenaVector<Pixel> Rasterize(Arena& arena, const ArenaVector<Pixel>& polygon)
+{
+	auto [left, right] = ComputePolygonRows(arena, polygon);
+
+	const int rows = int(left.size());
+
+	// NOTE: The pixels are counted first, so the vector never grows and leaves nothing behind in the arena.
+	size_t count = 0;
+	for (int row = 0; row < rows; ++row)
+		count += size_t(Interpolate(left[row], right[row]).size());
+
+	ArenaVector<Pixel> pixels { ArenaAllocator<Pixel>(arena) };
+	pixels.reserve(count);
+	for (int row = 0; row < rows; ++row)
+		for (const Pixel& pixel : Interpolate(left[row], right[row]))
+			pixels.push_back(pixel);
+
+	return pixels;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Which SIMD instructions the compiler can use, and the kernels that pick the
+// widest of them the CPU supports at runtime.
+//
+// `SIMD_X86` is 1 where SSE2 can always be used, with <immintrin.h> included.
+// `SIMD_AVX2` is 1 where AVX2 kernels can be compiled. Functions with AVX2
+// instructions are marked with `TARGET_AVX2` and must only be called after
+// checking the CPU for it, e.g. with `BestKernel`.
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SIMD_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+#else
+	#define SIMD_X86 0
+#endif
+
+// GCC and Clang compile the AVX2 kernels for AVX2 on their own and pick them at
+// runtime. MSVC can only use them when the whole program targets AVX2.
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+	#define SIMD_AVX2 1
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+#elif SIMD_X86 && defined(__AVX2__)
+	#define SIMD_AVX2 1
+	#define TARGET_AVX2
+#else
+	#define SIMD_AVX2 0
+	#define TARGET_AVX2
+#endif
+
+
+enum class Kernel
+{
+	SCALAR,
+	SSE,
+	AVX2,
+};
+
+inline const char* KernelName(Kernel kernel)
+{
+	switch (kernel)
+	{
+		case Kernel::SCALAR: return "scalar";
+		case Kernel::SSE:    return "sse";
+		case Kernel::AVX2:   return "avx2";
+	}
+	return "?";
+}
+
+/// The widest kernel this CPU can run.
+inline Kernel BestKernel()
+{
+#if SIMD_AVX2 && (defined(__GNUC__) || defined(__clang__))
+	if (__builtin_cpu_supports("avx2"))
+		return Kernel::AVX2;
+	return Kernel::SSE;
+#elif SIMD_AVX2
+	return Kernel::AVX2;
+#elif SIMD_X86
+	return Kernel::SSE;
+#else
+	return Kernel::SCALAR;
+#endif
+}
+
+/// Falls back to the widest supported kernel if `kernel` can't run on this CPU.
+inline Kernel SupportedKernel(Kernel kernel)
+{
+	return std::min(kernel, BestKernel());
+}
+
+#endif
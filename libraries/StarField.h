@@ -0,0 +1,207 @@
+#ifndef STAR_FIELD_H
+#define STAR_FIELD_H
+
+// Structure-of-arrays star storage and SIMD kernels to move and draw the stars
+// of Lab1's starfield.
+//
+// The kernels work on a range of stars, so the field can be split into chunks
+// that are processed on different threads. They evaluate the same expressions
+// in the same order as the scalar code, so every kernel moves the stars and
+// picks the pixels and colors bit-identically.
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+#include "ColorConversion.h"
+#include "Simd.h"
+
+
+/// Stars with each coordinate in its own array. `x` and `y` are in [-1, 1], and
+/// `z`, the distance in front of the camera, is kept in (0, 1] by `update`.
+class StarField
+{
+public:
+	void add(const glm::vec3& position)
+	{
+		xs.push_back(position.x);
+		ys.push_back(position.y);
+		zs.push_back(position.z);
+	}
+
+	int size() const { return int(zs.size()); }
+
+	glm::vec3 position(int i) const { return glm::vec3(xs[i], ys[i], zs[i]); }
+
+	/// Moves the stars `[begin, end)` by `-velocity * dt`. Stars that pass the camera
+	/// or the far end wrap around to the other end, which keeps `z` in (0, 1].
+	void update(int begin, int end, const glm::vec3& velocity, float dt, Kernel kernel)
+	{
+		glm::vec3 step = velocity * dt;
+		int i = begin;
+
+#if SIMD_AVX2
+		if (kernel == Kernel::AVX2)
+			i = this->update_avx2(begin, end, step);
+#endif
+#if SIMD_X86
+		if (kernel == Kernel::SSE)
+			i = this->update_sse(begin, end, step);
+#endif
+		(void) kernel;
+
+		for (; i < end; ++i)
+		{
+			xs[i] -= step.x;
+			ys[i] -= step.y;
+			zs[i] -= step.z;
+
+			// NOTE: The comparisons become 0 or 1, so there is no branch to mispredict.
+			zs[i] += float(zs[i] <= 0.0f);
+			zs[i] -= float(zs[i] > 1.0f);
+		}
+	}
+
+	/// Projects the stars `[begin, end)` with focal length `focal_length` and writes each
+	/// one in view to `pixels` (`width` x `height`, ARGB8888, with rows `stride` pixels
+	/// apart), in white that fades with the square of the distance. Where stars overlap,
+	/// the later one is kept.
+	void draw(int begin, int end, uint32_t* pixels, int width, int height, int stride, float focal_length, Kernel kernel) const
+	{
+		int i = begin;
+
+#if SIMD_AVX2
+		if (kernel == Kernel::AVX2)
+			i = this->draw_avx2(begin, end, pixels, width, height, stride, focal_length);
+#endif
+#if SIMD_X86
+		if (kernel == Kernel::SSE)
+			i = this->draw_sse(begin, end, pixels, width, height, stride, focal_length);
+#endif
+		(void) kernel;
+
+		for (; i < end; ++i)
+		{
+			auto u = int(focal_length * xs[i] / zs[i] + float(width)  / 2.0f);
+			auto v = int(focal_length * ys[i] / zs[i] + float(height) / 2.0f);
+
+			if (0 <= u && u < width && 0 <= v && v < height)
+				pixels[size_t(v) * size_t(stride) + size_t(u)] = Color(0.2f / (zs[i] * zs[i]));
+		}
+	}
+
+	/// The pixel of a star with brightness `brightness`, which is clamped to [0, 1].
+	static uint32_t Color(float brightness)
+	{
+		auto gray = uint32_t(std::min(std::max(brightness, 0.0f), 1.0f) * 255.0f);
+		return PackARGB(gray, gray, gray);
+	}
+
+private:
+#if SIMD_X86
+	int update_sse(int begin, int end, const glm::vec3& step)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 sx = _mm_set1_ps(step.x), sy = _mm_set1_ps(step.y), sz = _mm_set1_ps(step.z);
+
+		int i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			_mm_storeu_ps(&xs[i], _mm_sub_ps(_mm_loadu_ps(&xs[i]), sx));
+			_mm_storeu_ps(&ys[i], _mm_sub_ps(_mm_loadu_ps(&ys[i]), sy));
+
+			__m128 z = _mm_sub_ps(_mm_loadu_ps(&zs[i]), sz);
+			z = _mm_add_ps(z, _mm_and_ps(_mm_cmple_ps(z, _mm_setzero_ps()), one));
+			z = _mm_sub_ps(z, _mm_and_ps(_mm_cmpgt_ps(z, one), one));
+			_mm_storeu_ps(&zs[i], z);
+		}
+		return i;
+	}
+
+	int draw_sse(int begin, int end, uint32_t* pixels, int width, int height, int stride, float focal_length) const
+	{
+		const __m128 f = _mm_set1_ps(focal_length);
+		const __m128 half_width  = _mm_set1_ps(float(width)  / 2.0f);
+		const __m128 half_height = _mm_set1_ps(float(height) / 2.0f);
+
+		int i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 z = _mm_loadu_ps(&zs[i]);
+			__m128i u = _mm_cvttps_epi32(_mm_add_ps(_mm_div_ps(_mm_mul_ps(f, _mm_loadu_ps(&xs[i])), z), half_width));
+			__m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_div_ps(_mm_mul_ps(f, _mm_loadu_ps(&ys[i])), z), half_height));
+			__m128 brightness = _mm_div_ps(_mm_set1_ps(0.2f), _mm_mul_ps(z, z));
+
+			alignas(16) int32_t us[4], vs[4];
+			alignas(16) float   bs[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(us), u);
+			_mm_store_si128(reinterpret_cast<__m128i*>(vs), v);
+			_mm_store_ps(bs, brightness);
+			Scatter(us, vs, bs, 4, pixels, width, height, stride);
+		}
+		return i;
+	}
+#endif
+
+#if SIMD_AVX2
+	TARGET_AVX2 int update_avx2(int begin, int end, const glm::vec3& step)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 sx = _mm256_set1_ps(step.x), sy = _mm256_set1_ps(step.y), sz = _mm256_set1_ps(step.z);
+
+		int i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			_mm256_storeu_ps(&xs[i], _mm256_sub_ps(_mm256_loadu_ps(&xs[i]), sx));
+			_mm256_storeu_ps(&ys[i], _mm256_sub_ps(_mm256_loadu_ps(&ys[i]), sy));
+
+			__m256 z = _mm256_sub_ps(_mm256_loadu_ps(&zs[i]), sz);
+			z = _mm256_add_ps(z, _mm256_and_ps(_mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LE_OQ), one));
+			z = _mm256_sub_ps(z, _mm256_and_ps(_mm256_cmp_ps(z, one, _CMP_GT_OQ), one));
+			_mm256_storeu_ps(&zs[i], z);
+		}
+		return i;
+	}
+
+	TARGET_AVX2 int draw_avx2(int begin, int end, uint32_t* pixels, int width, int height, int stride, float focal_length) const
+	{
+		const __m256 f = _mm256_set1_ps(focal_length);
+		const __m256 half_width  = _mm256_set1_ps(float(width)  / 2.0f);
+		const __m256 half_height = _mm256_set1_ps(float(height) / 2.0f);
+
+		int i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 z = _mm256_loadu_ps(&zs[i]);
+			__m256i u = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(f, _mm256_loadu_ps(&xs[i])), z), half_width));
+			__m256i v = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(f, _mm256_loadu_ps(&ys[i])), z), half_height));
+			__m256 brightness = _mm256_div_ps(_mm256_set1_ps(0.2f), _mm256_mul_ps(z, z));
+
+			alignas(32) int32_t us[8], vs[8];
+			alignas(32) float   bs[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(us), u);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(vs), v);
+			_mm256_store_ps(bs, brightness);
+			Scatter(us, vs, bs, 8, pixels, width, height, stride);
+		}
+		return i;
+	}
+#endif
+
+	/// Writes the stars of one group of lanes that are in view, in order.
+	static void Scatter(const int32_t* us, const int32_t* vs, const float* brightness, int lanes, uint32_t* pixels, int width, int height, int stride)
+	{
+		for (int lane = 0; lane < lanes; ++lane)
+		{
+			// NOTE: Unsigned comparisons also reject negative coordinates.
+			if (uint32_t(us[lane]) < uint32_t(width) && uint32_t(vs[lane]) < uint32_t(height))
+				pixels[size_t(vs[lane]) * size_t(stride) + size_t(us[lane])] = Color(brightness[lane]);
+		}
+	}
+
+	std::vector<float> xs;
+	std::vector<float> ys;
+	std::vector<float> zs;
+};
+
+#endif
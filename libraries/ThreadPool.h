@@ -0,0 +1,222 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// A reusable pool of worker threads and a tile scheduler on top of it.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+
+/// A fixed set of threads, created once and reused by every `parallel_for`.
+///
+/// Each call splits its indices evenly over the threads (the calling thread
+/// included). A thread works through its own share from the front and, once
+/// it runs dry, steals indices from the back of the other threads' shares.
+/// Uneven work, like tiles that cover more geometry, is balanced that way.
+class ThreadPool
+{
+public:
+	static int DefaultThreadCount()
+	{
+		return std::max(1, int(std::thread::hardware_concurrency()));
+	}
+
+	explicit ThreadPool(int thread_count = DefaultThreadCount())
+		: thread_count(std::max(1, thread_count)), queues(new Queue[std::max(1, thread_count)])
+	{
+		for (int i = 1; i < this->thread_count; ++i)
+			workers.emplace_back([this, i]() { this->work(i); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator= (const ThreadPool&) = delete;
+
+	int size() const { return thread_count; }
+
+	/// Calls `task(i)` for every `i` in `[0, count)` and returns once all calls are done.
+	/// The calls are spread over the pool, so `task` must be safe to run concurrently.
+	template <typename Function>
+	void parallel_for(int count, Function&& task)
+	{
+		if (count <= 0)
+			return;
+
+		if (thread_count == 1 || count == 1)
+		{
+			for (int i = 0; i < count; ++i)
+				task(i);
+			return;
+		}
+
+		using Task = typename std::remove_reference<Function>::type;
+		job.context = const_cast<void*>(static_cast<const void*>(&task));
+		job.invoke  = [](void* context, int i) { (*static_cast<Task*>(context))(i); };
+
+		for (int t = 0; t < thread_count; ++t)
+		{
+			auto begin = Uint32(int64_t(count) * t       / thread_count);
+			auto end   = Uint32(int64_t(count) * (t + 1) / thread_count);
+			queues[t].range.store(Pack(begin, end), std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy_workers = thread_count - 1;
+			generation  += 1;
+		}
+		wake.notify_all();
+
+		this->run(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return busy_workers == 0; });
+	}
+
+private:
+	using Uint32 = std::uint32_t;
+	using Uint64 = std::uint64_t;
+
+	/// The indices `[begin, end)` left in one thread's share, packed so both ends can be
+	/// taken with a single compare-and-swap: the owner from the front, thieves from the back.
+	struct alignas(64) Queue
+	{
+		std::atomic<Uint64> range { 0 };
+	};
+
+	struct Job
+	{
+		void* context = nullptr;
+		void (*invoke)(void*, int) = nullptr;
+	};
+
+	static Uint64 Pack(Uint32 begin, Uint32 end) { return (Uint64(begin) << 32) | end; }
+	static Uint32 Begin(Uint64 range) { return Uint32(range >> 32); }
+	static Uint32 End(Uint64 range)   { return Uint32(range); }
+
+	static bool PopFront(Queue& queue, int& index)
+	{
+		Uint64 range = queue.range.load(std::memory_order_relaxed);
+		while (Begin(range) < End(range))
+		{
+			if (queue.range.compare_exchange_weak(range, Pack(Begin(range) + 1, End(range)), std::memory_order_relaxed))
+			{
+				index = int(Begin(range));
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool PopBack(Queue& queue, int& index)
+	{
+		Uint64 range = queue.range.load(std::memory_order_relaxed);
+		while (Begin(range) < End(range))
+		{
+			if (queue.range.compare_exchange_weak(range, Pack(Begin(range), End(range) - 1), std::memory_order_relaxed))
+			{
+				index = int(End(range) - 1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run(int id)
+	{
+		int index;
+		while (PopFront(queues[id], index))
+			job.invoke(job.context, index);
+
+		for (int offset = 1; offset < thread_count; ++offset)
+		{
+			Queue& victim = queues[(id + offset) % thread_count];
+			while (PopBack(victim, index))
+				job.invoke(job.context, index);
+		}
+	}
+
+	void work(int id)
+	{
+		Uint64 seen_generation = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&]() { return stopping || generation != seen_generation; });
+				if (stopping)
+					return;
+				seen_generation = generation;
+			}
+
+			this->run(id);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			busy_workers -= 1;
+			if (busy_workers == 0)
+				done.notify_one();
+		}
+	}
+
+	const int                thread_count;
+	std::unique_ptr<Queue[]> queues;
+	std::vector<std::thread> workers;
+	Job                      job;
+
+	std::mutex              mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	Uint64                  generation   = 0;
+	int                     busy_workers = 0;
+	bool                    stopping     = false;
+};
+
+
+/// Splits a `width` x `height` frame into square tiles and renders them on a thread pool.
+class TileScheduler
+{
+public:
+	TileScheduler(int thread_count, int tile_size)
+		: pool(thread_count), tile_size(std::max(1, tile_size)) {}
+
+	int thread_count() const { return pool.size(); }
+
+	/// Calls `render_tile(x_min, y_min, x_max, y_max)` once per tile, with exclusive upper bounds.
+	/// Tiles don't overlap, so each pixel is written by exactly one thread.
+	template <typename Function>
+	void for_each_tile(int width, int height, Function&& render_tile)
+	{
+		int tiles_x = (width  + tile_size - 1) / tile_size;
+		int tiles_y = (height + tile_size - 1) / tile_size;
+
+		pool.parallel_for(tiles_x * tiles_y, [&](int tile)
+		{
+			int x_min = (tile % tiles_x) * tile_size;
+			int y_min = (tile / tiles_x) * tile_size;
+			render_tile(x_min, y_min, std::min(x_min + tile_size, width), std::min(y_min + tile_size, height));
+		});
+	}
+
+	ThreadPool pool;
+	int        tile_size;
+};
+
+#endif
@@ -0,0 +1,468 @@
+#ifndef TRIANGLE_STORE_H
+#define TRIANGLE_STORE_H
+
+// Structure-of-arrays triangle storage and SIMD ray/triangle kernels.
+//
+// Each kernel tests one ray against up to 8 triangles at a time, or a packet
+// of 4 rays against one triangle. They all evaluate Möller-Trumbore in the
+// same order as `IntersectTriangle` (and without fused multiply-adds), so
+// every kernel gives bit-identical results.
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "Simd.h"
+
+/// The closest hit found so far by a leaf test.
+struct LeafHit
+{
+	float t;
+	int   triangle_index;
+};
+
+
+/// Four rays traced together, with each coordinate in its own array.
+/// Only the lanes set in the `active` bit mask are traced.
+struct RayPacket
+{
+	static const int LANES = 4;
+
+	alignas(16) float origin[3][LANES]    = {};
+	alignas(16) float direction[3][LANES] = {};
+	int active = 0;
+
+	void set(int lane, const glm::vec3& ray_origin, const glm::vec3& ray_direction)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			origin[axis][lane]    = ray_origin[axis];
+			direction[axis][lane] = ray_direction[axis];
+		}
+		active |= 1 << lane;
+	}
+
+	bool      is_active(int lane)      const { return (active & (1 << lane)) != 0; }
+	glm::vec3 lane_origin(int lane)    const { return glm::vec3(origin[0][lane],    origin[1][lane],    origin[2][lane]);    }
+	glm::vec3 lane_direction(int lane) const { return glm::vec3(direction[0][lane], direction[1][lane], direction[2][lane]); }
+};
+
+/// The closest hit found so far for each ray of a packet.
+struct PacketHit
+{
+	alignas(16) float t[RayPacket::LANES];
+	int triangle_index[RayPacket::LANES];
+};
+
+
+/// The edge form of each triangle (see `TriangleRecord`), with every
+/// coordinate in its own 32-byte aligned array. Slot `i` holds the triangle
+/// `order[i]`, where `order` is the leaf order of a BVH, so the triangles of a
+/// leaf are next to each other and can be loaded 8 at a time.
+class TriangleStore
+{
+public:
+	static const int LANES = 8;
+
+	enum Component { V0_X, V0_Y, V0_Z, E1_X, E1_Y, E1_Z, E2_X, E2_Y, E2_Z, COMPONENTS };
+
+	template <typename Record>
+	static TriangleStore Create(const std::vector<Record>& records, const std::vector<int>& order)
+	{
+		TriangleStore store;
+
+		// NOTE: Padded with a full block of degenerate (never hit) triangles at the
+		// end, so a kernel can load 8 slots from anywhere without a bounds check.
+		int slots = int(order.size());
+		store.blocks = (slots + LANES - 1) / LANES + 1;
+		store.data.resize(size_t(COMPONENTS) * store.blocks, Block());
+		store.indices.resize(size_t(store.blocks) * LANES, -1);
+
+		for (int i = 0; i < slots; ++i)
+		{
+			const Record& record = records[order[i]];
+			const float values[COMPONENTS] = {
+				record.v0.x, record.v0.y, record.v0.z,
+				record.e1.x, record.e1.y, record.e1.z,
+				record.e2.x, record.e2.y, record.e2.z,
+			};
+
+			for (int c = 0; c < COMPONENTS; ++c)
+				store.component(c)[i] = values[c];
+			store.indices[i] = order[i];
+		}
+
+		return store;
+	}
+
+	const float* component(int c) const { return data[size_t(c) * blocks].lanes; }
+	const int*   triangle_indices() const { return indices.data(); }
+
+private:
+	struct alignas(32) Block
+	{
+		float lanes[LANES] = { 0 };
+	};
+
+	float* component(int c) { return data[size_t(c) * blocks].lanes; }
+
+	std::vector<Block> data;
+	std::vector<int>   indices;
+	int                blocks = 0;
+};
+
+
+/// Keeps the closer of the current hit and a candidate, breaking ties by triangle index.
+inline void KeepCloser(LeafHit& hit, float t, int triangle_index)
+{
+	if (t < hit.t || (t == hit.t && triangle_index < hit.triangle_index))
+		hit = { t, triangle_index };
+}
+
+
+/// Like `KeepCloser` above, for one ray of a packet.
+inline void KeepCloser(PacketHit& hit, int lane, float t, int triangle_index)
+{
+	if (t < hit.t[lane] || (t == hit.t[lane] && triangle_index < hit.triangle_index[lane]))
+	{
+		hit.t[lane] = t;
+		hit.triangle_index[lane] = triangle_index;
+	}
+}
+
+
+// ---- Scalar ----
+
+inline float IntersectSlot(const TriangleStore& store, int slot, const glm::vec3& origin, const glm::vec3& direction)
+{
+	using C = TriangleStore;
+	glm::vec3 v0(store.component(C::V0_X)[slot], store.component(C::V0_Y)[slot], store.component(C::V0_Z)[slot]);
+	glm::vec3 e1(store.component(C::E1_X)[slot], store.component(C::E1_Y)[slot], store.component(C::E1_Z)[slot]);
+	glm::vec3 e2(store.component(C::E2_X)[slot], store.component(C::E2_Y)[slot], store.component(C::E2_Z)[slot]);
+
+	glm::vec3 p = glm::cross(direction, e2);
+	float determinant = glm::dot(e1, p);
+	if (determinant == 0.0f)
+		return std::numeric_limits<float>::infinity();
+
+	float inverse_determinant = 1.0f / determinant;
+
+	glm::vec3 s = origin - v0;
+	float u = glm::dot(s, p) * inverse_determinant;
+	if (u < 0.0f || u > 1.0f)
+		return std::numeric_limits<float>::infinity();
+
+	glm::vec3 q = glm::cross(s, e1);
+	float v = glm::dot(direction, q) * inverse_determinant;
+	if (v < 0.0f || u + v > 1.0f)
+		return std::numeric_limits<float>::infinity();
+
+	float t = glm::dot(e2, q) * inverse_determinant;
+	return t >= 0.0f ? t : std::numeric_limits<float>::infinity();
+}
+
+inline void IntersectLeafScalar(const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, LeafHit& hit)
+{
+	for (int slot = first; slot < first + count; ++slot)
+		KeepCloser(hit, IntersectSlot(store, slot, origin, direction), store.triangle_indices()[slot]);
+}
+
+inline bool OccludedLeafScalar(const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, float t_max)
+{
+	for (int slot = first; slot < first + count; ++slot)
+		if (IntersectSlot(store, slot, origin, direction) < t_max)
+			return true;
+	return false;
+}
+
+inline void IntersectPacketLeafScalar(const TriangleStore& store, int first, int count, const RayPacket& packet, PacketHit& hit)
+{
+	for (int slot = first; slot < first + count; ++slot)
+		for (int lane = 0; lane < RayPacket::LANES; ++lane)
+			if (packet.is_active(lane))
+				KeepCloser(hit, lane, IntersectSlot(store, slot, packet.lane_origin(lane), packet.lane_direction(lane)), store.triangle_indices()[slot]);
+}
+
+
+#if SIMD_X86
+
+// ---- SSE (4 lanes) ----
+
+/// Returns `t` in each lane that hits, and infinity in the others.
+inline __m128 IntersectSSE(const TriangleStore& store, int slot, const glm::vec3& origin, const glm::vec3& direction, int valid_lanes)
+{
+	using C = TriangleStore;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one  = _mm_set1_ps(1.0f);
+
+	__m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+
+	__m128 e1x = _mm_loadu_ps(store.component(C::E1_X) + slot);
+	__m128 e1y = _mm_loadu_ps(store.component(C::E1_Y) + slot);
+	__m128 e1z = _mm_loadu_ps(store.component(C::E1_Z) + slot);
+	__m128 e2x = _mm_loadu_ps(store.component(C::E2_X) + slot);
+	__m128 e2y = _mm_loadu_ps(store.component(C::E2_Y) + slot);
+	__m128 e2z = _mm_loadu_ps(store.component(C::E2_Z) + slot);
+
+	// p = cross(d, e2)
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(e2y, dz));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(e2z, dx));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(e2x, dy));
+
+	__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inverse_determinant = _mm_div_ps(one, determinant);
+
+	// s = origin - v0
+	__m128 sx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_loadu_ps(store.component(C::V0_X) + slot));
+	__m128 sy = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_loadu_ps(store.component(C::V0_Y) + slot));
+	__m128 sz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_loadu_ps(store.component(C::V0_Z) + slot));
+
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse_determinant);
+
+	// q = cross(s, e1)
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(e1y, sz));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(e1z, sx));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(e1x, sy));
+
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,  qx), _mm_mul_ps(dy,  qy)), _mm_mul_ps(dz,  qz)), inverse_determinant);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse_determinant);
+
+	__m128 miss = _mm_cmpeq_ps(determinant, zero);
+	miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmpgt_ps(u, one)));
+	miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmpgt_ps(_mm_add_ps(u, v), one)));
+	miss = _mm_or_ps(miss, _mm_cmpnge_ps(t, zero));
+	miss = _mm_or_ps(miss, _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(valid_lanes - 1))));
+
+	const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	return _mm_or_ps(_mm_and_ps(miss, infinity), _mm_andnot_ps(miss, t));
+}
+
+inline void IntersectLeafSSE(const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, LeafHit& hit)
+{
+	alignas(16) float t[4];
+	for (int slot = first; slot < first + count; slot += 4)
+	{
+		_mm_store_ps(t, IntersectSSE(store, slot, origin, direction, first + count - slot));
+		for (int lane = 0; lane < 4; ++lane)
+			if (t[lane] <= hit.t)
+				KeepCloser(hit, t[lane], store.triangle_indices()[slot + lane]);
+	}
+}
+
+inline bool OccludedLeafSSE(const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, float t_max)
+{
+	for (int slot = first; slot < first + count; slot += 4)
+	{
+		__m128 t = IntersectSSE(store, slot, origin, direction, first + count - slot);
+		if (_mm_movemask_ps(_mm_cmplt_ps(t, _mm_set1_ps(t_max))) != 0)
+			return true;
+	}
+	return false;
+}
+
+
+// ---- SSE packet (4 rays against one triangle) ----
+
+/// Returns `t` in each lane whose ray hits the triangle in `slot`, and infinity in the others.
+inline __m128 IntersectPacketSSE(const TriangleStore& store, int slot, const RayPacket& packet)
+{
+	using C = TriangleStore;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one  = _mm_set1_ps(1.0f);
+
+	__m128 dx = _mm_load_ps(packet.direction[0]), dy = _mm_load_ps(packet.direction[1]), dz = _mm_load_ps(packet.direction[2]);
+
+	__m128 e1x = _mm_set1_ps(store.component(C::E1_X)[slot]);
+	__m128 e1y = _mm_set1_ps(store.component(C::E1_Y)[slot]);
+	__m128 e1z = _mm_set1_ps(store.component(C::E1_Z)[slot]);
+	__m128 e2x = _mm_set1_ps(store.component(C::E2_X)[slot]);
+	__m128 e2y = _mm_set1_ps(store.component(C::E2_Y)[slot]);
+	__m128 e2z = _mm_set1_ps(store.component(C::E2_Z)[slot]);
+
+	// p = cross(d, e2)
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(e2y, dz));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(e2z, dx));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(e2x, dy));
+
+	__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inverse_determinant = _mm_div_ps(one, determinant);
+
+	// s = origin - v0
+	__m128 sx = _mm_sub_ps(_mm_load_ps(packet.origin[0]), _mm_set1_ps(store.component(C::V0_X)[slot]));
+	__m128 sy = _mm_sub_ps(_mm_load_ps(packet.origin[1]), _mm_set1_ps(store.component(C::V0_Y)[slot]));
+	__m128 sz = _mm_sub_ps(_mm_load_ps(packet.origin[2]), _mm_set1_ps(store.component(C::V0_Z)[slot]));
+
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse_determinant);
+
+	// q = cross(s, e1)
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(e1y, sz));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(e1z, sx));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(e1x, sy));
+
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,  qx), _mm_mul_ps(dy,  qy)), _mm_mul_ps(dz,  qz)), inverse_determinant);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse_determinant);
+
+	__m128 miss = _mm_cmpeq_ps(determinant, zero);
+	miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmpgt_ps(u, one)));
+	miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmpgt_ps(_mm_add_ps(u, v), one)));
+	miss = _mm_or_ps(miss, _mm_cmpnge_ps(t, zero));
+
+	const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	return _mm_or_ps(_mm_and_ps(miss, infinity), _mm_andnot_ps(miss, t));
+}
+
+inline void IntersectPacketLeafSSE(const TriangleStore& store, int first, int count, const RayPacket& packet, PacketHit& hit)
+{
+	alignas(16) float t[4];
+	for (int slot = first; slot < first + count; ++slot)
+	{
+		__m128 lanes = IntersectPacketSSE(store, slot, packet);
+
+		// Inactive lanes are masked out here, so their (garbage) rays never touch `hit`.
+		int candidates = _mm_movemask_ps(_mm_cmple_ps(lanes, _mm_load_ps(hit.t))) & packet.active;
+		if (candidates == 0)
+			continue;
+
+		_mm_store_ps(t, lanes);
+		for (int lane = 0; lane < 4; ++lane)
+			if (candidates & (1 << lane))
+				KeepCloser(hit, lane, t[lane], store.triangle_indices()[slot]);
+	}
+}
+
+#endif
+
+
+#if SIMD_AVX2
+
+// ---- AVX2 (8 lanes) ----
+
+/// Returns `t` in each lane that hits, and infinity in the others.
+TARGET_AVX2 inline __m256 IntersectAVX2(const TriangleStore& store, int slot, const glm::vec3& origin, const glm::vec3& direction, int valid_lanes)
+{
+	using C = TriangleStore;
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one  = _mm256_set1_ps(1.0f);
+
+	__m256 dx = _mm256_set1_ps(direction.x), dy = _mm256_set1_ps(direction.y), dz = _mm256_set1_ps(direction.z);
+
+	__m256 e1x = _mm256_loadu_ps(store.component(C::E1_X) + slot);
+	__m256 e1y = _mm256_loadu_ps(store.component(C::E1_Y) + slot);
+	__m256 e1z = _mm256_loadu_ps(store.component(C::E1_Z) + slot);
+	__m256 e2x = _mm256_loadu_ps(store.component(C::E2_X) + slot);
+	__m256 e2y = _mm256_loadu_ps(store.component(C::E2_Y) + slot);
+	__m256 e2z = _mm256_loadu_ps(store.component(C::E2_Z) + slot);
+
+	// p = cross(d, e2)
+	__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(e2y, dz));
+	__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(e2z, dx));
+	__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(e2x, dy));
+
+	__m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+	__m256 inverse_determinant = _mm256_div_ps(one, determinant);
+
+	// s = origin - v0
+	__m256 sx = _mm256_sub_ps(_mm256_set1_ps(origin.x), _mm256_loadu_ps(store.component(C::V0_X) + slot));
+	__m256 sy = _mm256_sub_ps(_mm256_set1_ps(origin.y), _mm256_loadu_ps(store.component(C::V0_Y) + slot));
+	__m256 sz = _mm256_sub_ps(_mm256_set1_ps(origin.z), _mm256_loadu_ps(store.component(C::V0_Z) + slot));
+
+	__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverse_determinant);
+
+	// q = cross(s, e1)
+	__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(e1y, sz));
+	__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(e1z, sx));
+	__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(e1x, sy));
+
+	__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx,  qx), _mm256_mul_ps(dy,  qy)), _mm256_mul_ps(dz,  qz)), inverse_determinant);
+	__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inverse_determinant);
+
+	__m256 miss = _mm256_cmp_ps(determinant, zero, _CMP_EQ_OQ);
+	miss = _mm256_or_ps(miss, _mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(u, one, _CMP_GT_OQ)));
+	miss = _mm256_or_ps(miss, _mm256_or_ps(_mm256_cmp_ps(v, zero, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_GT_OQ)));
+	miss = _mm256_or_ps(miss, _mm256_cmp_ps(t, zero, _CMP_NGE_UQ));
+	miss = _mm256_or_ps(miss, _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(valid_lanes - 1))));
+
+	return _mm256_blendv_ps(t, _mm256_set1_ps(std::numeric_limits<float>::infinity()), miss);
+}
+
+TARGET_AVX2 inline void IntersectLeafAVX2(const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, LeafHit& hit)
+{
+	alignas(32) float t[8];
+	for (int slot = first; slot < first + count; slot += 8)
+	{
+		__m256 lanes = IntersectAVX2(store, slot, origin, direction, first + count - slot);
+
+		int candidates = _mm256_movemask_ps(_mm256_cmp_ps(lanes, _mm256_set1_ps(hit.t), _CMP_LE_OQ));
+		if (candidates == 0)
+			continue;
+
+		_mm256_store_ps(t, lanes);
+		for (int lane = 0; lane < 8; ++lane)
+			if (candidates & (1 << lane))
+				KeepCloser(hit, t[lane], store.triangle_indices()[slot + lane]);
+	}
+}
+
+TARGET_AVX2 inline bool OccludedLeafAVX2(const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, float t_max)
+{
+	for (int slot = first; slot < first + count; slot += 8)
+	{
+		__m256 t = IntersectAVX2(store, slot, origin, direction, first + count - slot);
+		if (_mm256_movemask_ps(_mm256_cmp_ps(t, _mm256_set1_ps(t_max), _CMP_LT_OQ)) != 0)
+			return true;
+	}
+	return false;
+}
+
+#endif
+
+
+// ---- Dispatch ----
+
+/// Lowers `hit` to the closest triangle in slots `[first, first + count)`, if any is closer.
+inline void IntersectLeaf(Kernel kernel, const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, LeafHit& hit)
+{
+	switch (kernel)
+	{
+#if SIMD_AVX2
+		case Kernel::AVX2: IntersectLeafAVX2(store, first, count, origin, direction, hit); return;
+#endif
+#if SIMD_X86
+		case Kernel::SSE:  IntersectLeafSSE(store, first, count, origin, direction, hit);  return;
+#endif
+		default:           IntersectLeafScalar(store, first, count, origin, direction, hit);
+	}
+}
+
+/// Returns true if any triangle in slots `[first, first + count)` is hit closer than `t_max`.
+inline bool OccludedLeaf(Kernel kernel, const TriangleStore& store, int first, int count, const glm::vec3& origin, const glm::vec3& direction, float t_max)
+{
+	switch (kernel)
+	{
+#if SIMD_AVX2
+		case Kernel::AVX2: return OccludedLeafAVX2(store, first, count, origin, direction, t_max);
+#endif
+#if SIMD_X86
+		case Kernel::SSE:  return OccludedLeafSSE(store, first, count, origin, direction, t_max);
+#endif
+		default:           return OccludedLeafScalar(store, first, count, origin, direction, t_max);
+	}
+}
+
+/// Lowers each active lane of `hit` to the closest triangle its ray hits in slots `[first, first + count)`.
+/// The packet is only 4 wide, so the AVX2 kernel uses the SSE one.
+inline void IntersectPacketLeaf(Kernel kernel, const TriangleStore& store, int first, int count, const RayPacket& packet, PacketHit& hit)
+{
+#if SIMD_X86
+	if (kernel != Kernel::SCALAR)
+	{
+		IntersectPacketLeafSSE(store, first, count, packet, hit);
+		return;
+	}
+#endif
+	(void)kernel;
+	IntersectPacketLeafScalar(store, first, count, packet, hit);
+}
+
+#endif
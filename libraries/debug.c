@@ -1,3 +1,8 @@
+#include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
 #define Assert(statement, ...) _Assert(statement, #statement, __FILE__, __LINE__, __VA_ARGS__)
 void _Assert(bool status, const char* statement, const char* file, unsigned line, const char* message, ...)
 {
@@ -0,0 +1,128 @@
+#include "test.h"
+#include "RayTracing.h"
+#include "ThreadPool.h"
+#include "Arena.h"
+#include "Scanline.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using glm::vec3;
+
+
+// Every heap allocation in the program goes through these, so counting
+// them here tells exactly how many allocations a piece of code makes.
+static std::atomic<long> allocations { 0 };
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept              { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+
+
+const int WIDTH  = 100;
+const int HEIGHT = 100;
+
+/// Renders the Cornell box with `ShadeTile`, like Lab2's `Draw`.
+void RenderFrame(TileScheduler& scheduler, const Scene& scene, const Light& light, TraceMode mode, std::vector<vec3>& frame)
+{
+    PrimaryRays rays = { vec3(0, 0, 2), vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1), -float(HEIGHT) / 2.0f, WIDTH, HEIGHT };
+
+    scheduler.for_each_tile(WIDTH, HEIGHT, [&](int x_min, int y_min, int x_max, int y_max)
+    {
+        ShadeTile(scene, light, rays, mode, x_min, y_min, x_max, y_max, frame.data());
+    });
+}
+
+
+Test(RenderingAFrameDoesNotAllocate)
+{
+    const Scene scene = Scene::Create(LoadTestModel());
+    const Light light = { vec3(0, -0.7f, 0.7f), vec3(14), vec3(0.5f) };
+
+    std::vector<vec3> frame(WIDTH * HEIGHT);
+
+    for (TraceMode mode : { TraceMode::SINGLE, TraceMode::PACKET })
+    {
+        for (int threads : { 1, 4 })
+        {
+            TileScheduler scheduler(threads, 16);
+            RenderFrame(scheduler, scene, light, mode, frame);  // Warm up.
+
+            long before = allocations.load();
+            for (int i = 0; i < 5; ++i)
+                RenderFrame(scheduler, scene, light, mode, frame);
+            long after = allocations.load();
+
+            Checkf(after - before, ==, 0L, "Threads %s, packets %s", threads, int(mode == TraceMode::PACKET));
+        }
+    }
+}
+
+/// Rasterizes `triangles` triangles fanned around the middle of a 500x500 screen with
+/// Lab3's scanline `Rasterize`, one at a time like its `Draw`. The pixels they cover.
+long ScanlineFrame(Arena& arena, int triangles)
+{
+    arena.reset();
+
+    long covered = 0;
+    for (int i = 0; i < triangles; ++i)
+    {
+        Arena::Marker marker = arena.mark();
+        {
+            const int size = 20 + 10 * (i % 20);
+            Pixel a { 250, 250, 1.0f, vec3(0) };
+            Pixel b { 250 + size * (i % 3 - 1), 250 - size, 0.5f, vec3(1) };
+            Pixel c { 250 + size, 250 + size * (i % 5 - 2) / 2, 0.25f, vec3(2) };
+
+            ArenaVector<Pixel> polygon({ a, b, c }, ArenaAllocator<Pixel>(arena));
+            ArenaVector<Pixel> pixels = Rasterize(arena, polygon);
+            covered += long(pixels.size());
+        }
+        arena.rewind(marker);
+    }
+
+    return covered;
+}
+
+Test(ScanlineFramesDoNotAllocate)
+{
+    Arena arena(1024);
+    ScanlineFrame(arena, 30);  // Warm up, which grows the arena.
+    ScanlineFrame(arena, 30);
+    Check(arena.block_count(), ==, 1);
+
+    long before  = allocations.load();
+    long covered = 0;
+    for (int i = 0; i < 5; ++i)
+        covered += ScanlineFrame(arena, 30);
+    long after = allocations.load();
+
+    Check(after - before, ==, 0L);
+    Check(covered, >, 0L);
+}
+
+Test(AllocationCounterSeesAllocations)
+{
+    long before = allocations.load();
+    std::vector<int>* numbers = new std::vector<int>(100);
+    long after = allocations.load();
+    delete numbers;
+
+    Check(after - before, ==, 2L);
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}
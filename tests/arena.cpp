@@ -0,0 +1,94 @@
+#include "test.h"
+#include "Arena.h"
+
+#include <cstdint>
+#include <vector>
+
+
+Test(AllocationsAreAlignedAndDisjoint)
+{
+    Arena arena(256);
+
+    std::vector<unsigned char*> blocks;
+    for (size_t alignment : { 1, 2, 4, 8, 16, 32, 64 }) {
+        auto block = static_cast<unsigned char*>(arena.allocate(3, alignment));
+        Checkf(reinterpret_cast<uintptr_t>(block) % alignment, ==, uintptr_t(0), "Alignment %s", int(alignment));
+        for (int i = 0; i < 3; ++i)
+            block[i] = (unsigned char)(blocks.size());
+        blocks.push_back(block);
+    }
+
+    // NOTE: Every block still holds what was written to it, so none of them overlap.
+    for (size_t i = 0; i < blocks.size(); ++i)
+        for (int j = 0; j < 3; ++j)
+            Checkf(int(blocks[i][j]), ==, int(i), "Block %s", int(i));
+
+    Check(arena.used(), ==, size_t(3 * 7));
+}
+
+Test(ResetReusesTheMemory)
+{
+    Arena arena(1024);
+
+    void* first = arena.allocate(100, 16);
+    arena.allocate(200, 16);
+    arena.reset();
+
+    Check(arena.used(), ==, size_t(0));
+    Check(int(arena.allocate(100, 16) == first), ==, 1);
+}
+
+Test(FullArenaGrowsToFitTheWholeFrame)
+{
+    Arena arena(64);
+
+    for (int i = 0; i < 10; ++i)
+        arena.allocate(48, 8);
+    Check(arena.block_count(), >, 1);
+    Check(arena.capacity(), >=, size_t(480));
+
+    // NOTE: The next frame of the same size fits in the one block made by `reset`.
+    arena.reset();
+    Check(arena.block_count(), ==, 1);
+    for (int i = 0; i < 10; ++i)
+        arena.allocate(48, 8);
+    Check(arena.block_count(), ==, 1);
+}
+
+Test(RewindFreesWhatCameAfterTheMarker)
+{
+    Arena arena(1024);
+
+    arena.allocate(10, 1);
+    Arena::Marker marker = arena.mark();
+    void* first = arena.allocate(100, 8);
+    arena.rewind(marker);
+
+    Check(arena.used(), ==, size_t(10));
+    Check(int(arena.allocate(100, 8) == first), ==, 1);
+}
+
+Test(VectorsTakeTheirMemoryFromTheArena)
+{
+    Arena arena(1 << 16);
+
+    ArenaVector<int> numbers { ArenaAllocator<int>(arena) };
+    numbers.reserve(100);
+    for (int i = 0; i < 100; ++i)
+        numbers.push_back(i * i);
+
+    Check(arena.used(), ==, 100 * sizeof(int));
+    for (int i = 0; i < 100; ++i)
+        Check(numbers[i], ==, i * i);
+
+    // NOTE: Allocators of other types share the arena.
+    ArenaVector<double> doubles(numbers.begin(), numbers.end(), ArenaAllocator<double>(numbers.get_allocator()));
+    Check(doubles.back(), ==, 99.0 * 99.0);
+    Check(arena.used(), ==, 100 * sizeof(int) + 100 * sizeof(double));
+}
+
+
+int main()
+{
+    RunAllTests();
+}
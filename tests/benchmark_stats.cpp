@@ -0,0 +1,59 @@
+#include "test.h"
+#include "Benchmark.h"
+
+#include <string>
+#include <vector>
+
+
+Test(PercentilesUseNearestRank)
+{
+    std::vector<double> sorted;
+    for (int i = 1; i <= 100; ++i)
+        sorted.push_back(double(i));
+
+    Check(Benchmark::Percentile(sorted, 50), ==, 50.0);
+    Check(Benchmark::Percentile(sorted, 95), ==, 95.0);
+    Check(Benchmark::Percentile(sorted, 99), ==, 99.0);
+    Check(Benchmark::Percentile(sorted, 0),  ==, 1.0);
+
+    std::vector<double> single = { 7.0 };
+    Check(Benchmark::Percentile(single, 99), ==, 7.0);
+}
+
+Test(SummarySkipsWarmupFrames)
+{
+    Benchmark benchmark("Test", "items", 2);
+    benchmark.record(100.0, 1000);  // Warm-up.
+    benchmark.record(100.0, 1000);  // Warm-up.
+    benchmark.record(3.0, 30);
+    benchmark.record(1.0, 10);
+    benchmark.record(2.0, 20);
+
+    Benchmark::Summary summary = benchmark.summary();
+    Check(summary.frames,     ==, 3);
+    Check(summary.mean,       ==, 2.0);
+    Check(summary.median,     ==, 2.0);
+    Check(summary.min,        ==, 1.0);
+    Check(summary.max,        ==, 3.0);
+    Check(summary.throughput, ==, 10.0);
+}
+
+Test(JsonHasAllFields)
+{
+    Benchmark benchmark("Test", "items", 0);
+    benchmark.set("width", 320);
+    benchmark.set("kernel", "avx2");
+    benchmark.record(0.002, 50);
+
+    std::string json = benchmark.json();
+    for (const char* field : { "\"benchmark\": \"Test\"", "\"width\": 320", "\"kernel\": \"avx2\"", "\"frames\": 1",
+                               "\"median\": 2.0000", "\"p95\"", "\"p99\"", "\"items_per_second\": 25000.0" })
+        Checkf(json.find(field) != std::string::npos, ==, true, "Field %s", field);
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,110 @@
+#include "test.h"
+#include "SDL_helper.h"
+
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using glm::vec3;
+
+
+float RandomFloat(float low, float high)
+{
+    return low + (high - low) * (float(rand()) / float(RAND_MAX));
+}
+
+
+Test(BatchMatchesColorCode)
+{
+    srand(1);
+    for (int count = 0; count < 14; ++count)  // Every tail length after the 4-pixel steps.
+    {
+        std::vector<vec3> colors;
+        for (int i = 0; i < count; ++i)
+            colors.push_back(vec3(RandomFloat(0, 1), RandomFloat(0, 1), RandomFloat(0, 1)));
+        if (count > 2)
+            colors[2] = vec3(0.0f, 1.0f, 1.0039f);  // The edges of what `ColorCode` accepts.
+
+        std::vector<Uint32> pixels(count + 1, 0xDEADBEEF);
+        ConvertToARGB(colors.data(), pixels.data(), count);
+
+        for (int i = 0; i < count; ++i)
+            Checkf(pixels[i], ==, ColorCode(colors[i]), "Pixel %s", i);
+        Check(pixels[count], ==, 0xDEADBEEF);  // Nothing is written past the end.
+    }
+}
+
+Test(BatchClampsOutOfRange)
+{
+    const float nan      = std::numeric_limits<float>::quiet_NaN();
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    vec3 colors[5] = {
+        vec3(-1.0f, 2.0f, 0.5f),
+        vec3(1e10f, -1e10f, infinity),
+        vec3(nan, -infinity, 1.0f),
+        vec3(0.25f, 0.5f, 0.75f),
+        vec3(nan, nan, nan),  // Converted on its own, after the 4-pixel step.
+    };
+    Uint32 pixels[5];
+    ConvertToARGB(colors, pixels, 5);
+
+    Check(pixels[0], ==, PackARGB(0, 255, 127));
+    Check(pixels[1], ==, PackARGB(255, 0, 255));
+    Check(pixels[2], ==, PackARGB(0, 0, 255));
+    Check(pixels[3], ==, ColorCode(colors[3]));
+    Check(pixels[4], ==, PackARGB(0, 0, 0));
+}
+
+Test(BatchAppliesGammaTable)
+{
+    srand(2);
+    GammaTable gamma = GammaTable::Create(2.2f);
+
+    Check(int(gamma[0]), ==, 0);
+    Check(int(gamma[GammaTable::SIZE - 1]), ==, 255);
+    Check(int(gamma[GammaTable::Index(0.5f)]), ==, 186);  // 0.5^(1/2.2) * 255 = 186.1
+
+    std::vector<vec3> colors;
+    for (int i = 0; i < 11; ++i)
+        colors.push_back(vec3(RandomFloat(-0.1f, 1.1f), RandomFloat(-0.1f, 1.1f), RandomFloat(-0.1f, 1.1f)));
+
+    std::vector<Uint32> pixels(colors.size());
+    ConvertToARGB(colors.data(), pixels.data(), int(colors.size()), &gamma);
+    for (size_t i = 0; i < colors.size(); ++i)
+        Checkf(pixels[i], ==, ConvertToARGB(colors[i], gamma), "Pixel %s", int(i));
+}
+
+Test(GradientRowMatchesInterpolatedColors)
+{
+    Gradient gradient = { RED, BLUE, GREEN, YELLOW };
+    auto lerp = [](const vec3& start, const vec3& stop, float t) { return start * (1.0f - t) + stop * t; };
+
+    for (int width : { 1, 3, 4, 7, 640 })
+    {
+        int height = 5;
+        std::vector<Uint32> pixels(width + 1, 0xDEADBEEF);
+        for (int y = 0; y < height; ++y)
+        {
+            GradientRow(gradient, y, width, height, pixels.data());
+
+            vec3 left  = lerp(RED,  GREEN,  float(y) / float(height));
+            vec3 right = lerp(BLUE, YELLOW, float(y) / float(height));
+            for (int x = 0; x < width; ++x)
+                Checkf(pixels[x], ==, ColorCode(lerp(left, right, float(x) / float(width))), "Pixel %s", x);
+            Check(pixels[width], ==, 0xDEADBEEF);
+        }
+    }
+
+    // NOTE: The first pixel is exactly the top left color.
+    Uint32 pixel;
+    GradientRow(gradient, 0, 1, 1, &pixel);
+    Check(pixel, ==, ColorCode(RED));
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}
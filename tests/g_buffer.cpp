@@ -0,0 +1,105 @@
+#include "test.h"
+#include "GBuffer.h"
+
+#include <cstdlib>
+#include <vector>
+
+using glm::vec3;
+
+
+float RandomFloat(float low, float high)
+{
+    return low + (high - low) * (float(rand()) / float(RAND_MAX));
+}
+
+
+Test(LightRowMatchesFalloff)
+{
+    srand(1);
+    const int width  = 23;  // Not a multiple of 4, so the last pixels take the scalar path.
+    const int height = 5;
+
+    std::vector<vec3> normals;
+    for (int i = 0; i < 10; ++i)
+        normals.push_back(glm::normalize(vec3(RandomFloat(-1, 1), RandomFloat(-1, 1), RandomFloat(-1, 1))));
+
+    GBuffer g_buffer;
+    g_buffer.resize(width, height);
+    g_buffer.clear();
+
+    std::vector<vec3> positions(width * height);
+    std::vector<int>  triangles(width * height, GBuffer::EMPTY);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            if (rand() % 4 == 0)
+                continue;  // Left empty.
+
+            positions[y * width + x] = vec3(RandomFloat(-1, 1), RandomFloat(-1, 1), RandomFloat(-1, 1));
+            triangles[y * width + x] = rand() % 10;
+            g_buffer.write(x, y, triangles[y * width + x], positions[y * width + x]);
+        }
+
+    PointLight light = { vec3(0.1f, -0.5f, -0.7f), vec3(10) };
+    auto normal_of = [&](int index) { return normals[index]; };
+
+    for (int y = 0; y < height; ++y)
+    {
+        int next = 0;
+        LightRow(g_buffer, y, light, normal_of, [&](int x, int triangle, float falloff) {
+            Check(x, ==, next);  // Every pixel, in order.
+            next += 1;
+
+            int expected = triangles[y * width + x];
+            Checkf(triangle, ==, expected, "Pixel %s", x);
+            float expected_falloff = expected == GBuffer::EMPTY ? 0.0f : Falloff(light, positions[y * width + x], normals[expected]);
+            Checkf(glm::abs(falloff - expected_falloff), <=, 1e-6f * expected_falloff, "Pixel %s", x);
+        });
+        Check(next, ==, width);
+    }
+}
+
+Test(ClearEmptiesRectangle)
+{
+    GBuffer g_buffer;
+    g_buffer.resize(8, 8);
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+            g_buffer.write(x, y, 1, vec3(0));
+
+    g_buffer.clear(2, 3, 6, 5);
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+        {
+            bool inside = x >= 2 && x < 6 && y >= 3 && y < 5;
+            Checkf(g_buffer.triangles(y)[x], ==, inside ? GBuffer::EMPTY : 1, "Pixel %s", x);
+        }
+}
+
+Test(ClearEmptiesEveryRow)
+{
+    GBuffer g_buffer;
+    g_buffer.resize(8, 8);
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+            g_buffer.write(x, y, 1, vec3(0));
+
+    // NOTE: The end of the last row is the end of the buffer.
+    g_buffer.clear();
+    int filled = 0;
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+            filled += g_buffer.triangles(y)[x] != GBuffer::EMPTY;
+    Check(filled, ==, 0);
+
+    GBuffer empty;
+    empty.resize(0, 0);
+    empty.clear();
+    Check(empty.width(), ==, 0);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -1,4 +1,8 @@
 #include "test.h"
+#include "Interpolation.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <vector>
 
 
@@ -97,6 +101,208 @@ Test(Lerp3)
     }
 }
 
+Test(RangeHitsEveryInteger)
+{
+    Interpolation<float> range = Interpolation<float>::Between(0.0f, 499.0f, 500);
+    Check(range.size(), ==, 500);
+
+    int i = 0;
+    for (float value : range) {
+        Checkf(int(value), ==, i, "%s != %s", value, float(i));
+        ++i;
+    }
+    Check(i, ==, 500);
+}
+
+Test(RangeValuesComeFromTheirIndex)
+{
+    Interpolation<glm::vec3> range = Interpolation<glm::vec3>::Between(glm::vec3(3.0f, -1.0f, 0.25f), glm::vec3(-7.5f, 2.0f, 0.5f), 37);
+    Check(range.size(), ==, 37);
+    Checkf(range[0] == range.start(), ==, true, "%s", range[0].x);
+    Checkf(glm::all(glm::lessThan(glm::abs(range[36] - glm::vec3(-7.5f, 2.0f, 0.5f)), glm::vec3(1e-5f))), ==, true, "%s", range[36].x);
+
+    // NOTE: The components are ranges of their own, with the same values.
+    Interpolation<float> y = range.component(1);
+    int i = 0;
+    for (glm::vec3 value : range) {
+        Checkf(value.y, ==, y[i], "Value %s", i);
+        ++i;
+    }
+
+    Interpolation<float> single = Interpolation<float>::Between(4.0f, 9.0f, 1);
+    Check(single.size(), ==, 1);
+    Check(single[0], ==, 4.0f);
+    Check(Interpolation<float>(0.0f, 1.0f, -3).size(), ==, 0);
+
+#if SIMD_X86
+    Interpolation<float> x = range.component(0);
+    for (int first = 0; first + 4 <= x.size(); first += 4) {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, LoadSSE(x, first));
+        for (int lane = 0; lane < 4; ++lane)
+            Checkf(lanes[lane], ==, x[first + lane], "Value %s", first + lane);
+    }
+#endif
+}
+
+
+/// `floor(start + (stop - start) * i / steps)`, through doubles. The quotient of two
+/// small integers is never close enough to an integer to round onto it.
+int ExactStep(int start, int stop, int steps, int i)
+{
+    return start + int(std::floor(double(stop - start) * double(i) / double(steps)));
+}
+
+Test(DdaMatchesExactValues)
+{
+    int mismatches = 0;
+    int wrong_ends = 0;
+    for (int start = -40; start <= 40; ++start)
+        for (int stop = -40; stop <= 40; ++stop)
+            for (int steps = 1; steps <= 40; ++steps) {
+                Dda dda(start, stop, steps);
+                for (int i = 0; i <= steps; ++i, dda.next()) {
+                    int exact = ExactStep(start, stop, steps, i);
+                    mismatches += int(dda.value() != exact || Dda::At(start, stop, steps, i) != exact);
+                }
+                wrong_ends += int(Dda::At(start, stop, steps, steps) != stop);
+            }
+
+    // NOTE: The longest lines are where the error of the rounded up step adds up the most.
+    for (int steps : { 1000, 4095, 40000, Dda::MAX_STEPS })
+        for (int delta : { 1, 7, -7, 499, -1000, 65535, -65535, 1 << 20 }) {
+            Dda dda(-3, -3 + delta, steps);
+            for (int i = 0; i <= steps; ++i, dda.next())
+                mismatches += int(dda.value() != ExactStep(-3, -3 + delta, steps, i));
+            wrong_ends += int(Dda::At(-3, -3 + delta, steps, steps) != -3 + delta);
+        }
+
+    Check(mismatches, ==, 0);
+    Check(wrong_ends, ==, 0);
+}
+
+/// The pairs of `start` and `stop` in [0, `size`) where a line made by `value(start, stop, n, i)`,
+/// with `n = |stop - start| + 1` values, doesn't hit every integer between them exactly once.
+template <typename Value>
+int CountGappyLines(int size, Value value)
+{
+    int gappy = 0;
+    for (int start = 0; start < size; ++start)
+        for (int stop = 0; stop < size; ++stop) {
+            int n         = std::abs(stop - start) + 1;
+            int direction = stop < start ? -1 : 1;
+            bool exact    = true;
+            for (int i = 0; i < n; ++i)
+                exact &= value(start, stop, n, i) == start + direction * i;
+            gappy += int(!exact);
+        }
+    return gappy;
+}
+
+Test(OnlyDdaHitsEveryIntegerOfEveryLine)
+{
+    const int size = 256;
+
+    int dda = CountGappyLines(size, [](int start, int stop, int n, int i) {
+        return Dda::At(start, stop, std::max(n - 1, 1), i);
+    });
+    int range = CountGappyLines(size, [](int start, int stop, int n, int i) {
+        return int(Interpolation<float>::Between(float(start), float(stop), n)[i]);
+    });
+    int lerp[3] = {
+        CountGappyLines(size, [](int start, int stop, int n, int i) { return int(lerp1(float(start), float(stop), float(i) / float(std::max(n - 1, 1)))); }),
+        CountGappyLines(size, [](int start, int stop, int n, int i) { return int(lerp2(float(start), float(stop), float(i) / float(std::max(n - 1, 1)))); }),
+        CountGappyLines(size, [](int start, int stop, int n, int i) { return int(lerp3(float(start), float(stop), float(i) / float(std::max(n - 1, 1)))); }),
+    };
+
+    // NOTE: Stepping a float is stateful, so it's checked a line at a time.
+    int stepped = 0;
+    for (int start = 0; start < size; ++start)
+        for (int stop = 0; stop < size; ++stop) {
+            int   n       = std::abs(stop - start) + 1;
+            float step    = float(stop - start) / float(std::max(n - 1, 1));
+            float current = float(start);
+            bool  exact   = true;
+            for (int i = 0; i < n; ++i, current += step)
+                exact &= int(current) == start + (stop < start ? -i : i);
+            stepped += int(!exact);
+        }
+
+    std::printf("\nLines of %d x %d with gaps: dda %d, range %d, lerp1 %d, lerp2 %d, lerp3 %d, stepped %d\n",
+        size, size, dda, range, lerp[0], lerp[1], lerp[2], stepped);
+
+    // NOTE: Only the DDA is guaranteed; the float variants are reported for comparison.
+    Check(dda, ==, 0);
+}
+
+/// Nanoseconds per value of `line(start, stop, n)`, which makes the values of a line from
+/// `start` to `stop` and returns their sum, over every line in [0, `size`).
+template <typename Line>
+double NanosecondsPerValue(int size, Line line, long long& sum)
+{
+    auto      begin  = std::chrono::steady_clock::now();
+    long long values = 0;
+    for (int start = 0; start < size; start += 3)
+        for (int stop = 0; stop < size; stop += 5) {
+            int n = std::abs(stop - start) + 1;
+            sum    += line(start, stop, n);
+            values += n;
+        }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / double(values);
+}
+
+Test(InterpolationThroughput)
+{
+    const int size = 500;
+
+    auto lerp_line = [](float (*lerp)(float, float, float)) {
+        return [lerp](int start, int stop, int n) {
+            long long sum = 0;
+            for (int i = 0; i < n; ++i)
+                sum += int(lerp(float(start), float(stop), float(i) / float(std::max(n - 1, 1))));
+            return sum;
+        };
+    };
+
+    long long sums[6] = {};
+    double times[6] = {
+        NanosecondsPerValue(size, lerp_line(lerp1), sums[0]),
+        NanosecondsPerValue(size, lerp_line(lerp2), sums[1]),
+        NanosecondsPerValue(size, lerp_line(lerp3), sums[2]),
+        NanosecondsPerValue(size, [](int start, int stop, int n) {
+            long long sum  = 0;
+            float current  = float(start);
+            float step     = float(stop - start) / float(std::max(n - 1, 1));
+            for (int i = 0; i < n; ++i, current += step)
+                sum += int(current);
+            return sum;
+        }, sums[3]),
+        NanosecondsPerValue(size, [](int start, int stop, int n) {
+            long long sum = 0;
+            for (float value : Interpolation<float>::Between(float(start), float(stop), n))
+                sum += int(value);
+            return sum;
+        }, sums[4]),
+        NanosecondsPerValue(size, [](int start, int stop, int n) {
+            long long sum = 0;
+            Dda dda(start, stop, std::max(n - 1, 1));
+            for (int i = 0; i < n; ++i, dda.next())
+                sum += dda.value();
+            return sum;
+        }, sums[5]),
+    };
+
+    std::printf("\nNanoseconds per value: lerp1 %.2f, lerp2 %.2f, lerp3 %.2f, stepped %.2f, range %.2f, dda %.2f\n",
+        times[0], times[1], times[2], times[3], times[4], times[5]);
+
+    // NOTE: The sums keep the loops from being optimized away, and the DDA's is exact.
+    long long exact = 0;
+    for (int start = 0; start < size; start += 3)
+        for (int stop = 0; stop < size; stop += 5)
+            exact += (long long)(start + stop) * (std::abs(stop - start) + 1) / 2;
+    Check(sums[5], ==, exact);
+}
 
 
 int main()
@@ -0,0 +1,110 @@
+#include "test.h"
+#include "Log.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/// Everything written to `file` so far.
+std::string Contents(FILE* file)
+{
+    std::string text;
+    std::rewind(file);
+    for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file))
+        text += char(c);
+    return text;
+}
+
+Test(MessagesAreWrittenInOrder)
+{
+    FILE* file = std::tmpfile();
+    {
+        Log log(LogLevel::INFO, file);
+        for (int i = 0; i < 100; ++i)
+            log.write(LogLevel::INFO, "Message %d", i);
+        log.flush();
+    }
+
+    std::string text = Contents(file);
+    size_t last = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        size_t found = text.find("[info] Message " + std::to_string(i) + "\n");
+        Checkf(found != std::string::npos && found >= last, ==, true, "Message %s", i);
+        last = found;
+    }
+    std::fclose(file);
+}
+
+Test(MessagesBelowLevelAreSkipped)
+{
+    FILE* file = std::tmpfile();
+    {
+        Log log(LogLevel::WARNING, file);
+        log.write(LogLevel::DEBUG,   "hidden");
+        log.write(LogLevel::INFO,    "hidden");
+        log.write(LogLevel::WARNING, "shown");
+        log.write(LogLevel::ERROR,   "shown");
+    }
+
+    std::string text = Contents(file);
+    Check(text.find("hidden"), ==, std::string::npos);
+    Check(text, ==, std::string("[warning] shown\n[error] shown\n"));
+    std::fclose(file);
+}
+
+Test(ManyThreadsCanLog)
+{
+    FILE* file = std::tmpfile();
+    long long dropped;
+    {
+        Log log(LogLevel::INFO, file);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&log, t]() {
+                for (int i = 0; i < 200; ++i)
+                    log.write(LogLevel::INFO, "%d %d", t, i);
+            });
+        for (std::thread& thread : threads)
+            thread.join();
+
+        log.flush();
+        dropped = log.dropped_count();
+    }
+
+    // NOTE: Messages that don't fit are dropped instead of waited on, but every one is accounted for.
+    std::string text = Contents(file);
+    long long written = 0;
+    for (size_t found = text.find("[info]"); found != std::string::npos; found = text.find("[info]", found + 1))
+        written += 1;
+    Check(written + dropped, ==, 800LL);
+    std::fclose(file);
+}
+
+Test(PeriodicFiresOncePerInterval)
+{
+    Periodic periodic(1.0);
+
+    Check(periodic.tick(0.4), ==, false);
+    Check(periodic.tick(0.4), ==, false);
+    Check(periodic.tick(0.4), ==, true);
+    Check(periodic.frame_count(), ==, 3);
+    Checkf(std::abs(periodic.mean() - 0.4) < 1e-9, ==, true, "Mean %s", periodic.mean());
+
+    // NOTE: The frames are counted again from the one after the summary.
+    Check(periodic.tick(0.5), ==, false);
+    Check(periodic.frame_count(), ==, 1);
+    Check(periodic.tick(0.5), ==, true);
+    Check(periodic.elapsed_time(), ==, 1.0);
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}
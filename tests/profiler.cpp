@@ -0,0 +1,78 @@
+#include "test.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+
+Test(HistoryKeepsLatestFrames)
+{
+    Profiler profiler(4);
+    for (int i = 1; i <= 6; ++i)
+        profiler.add_frame_time(double(i));
+
+    // NOTE: Only 3, 4, 5 and 6 are left.
+    Check(profiler.frame_count(),    ==, 6);
+    Check(profiler.percentile(0),    ==, 3.0);
+    Check(profiler.percentile(50),   ==, 4.0);
+    Check(profiler.percentile(100),  ==, 6.0);
+}
+
+Test(HistogramClampsSlowFrames)
+{
+    Profiler profiler;
+    for (double seconds : { 0.0005, 0.0015, 0.0019, 0.0031, 1.0 })
+        profiler.add_frame_time(seconds);
+
+    std::vector<int> buckets = profiler.histogram(0.001, 3);
+    Check(int(buckets.size()), ==, 3);
+    Check(buckets[0], ==, 1);
+    Check(buckets[1], ==, 2);
+    Check(buckets[2], ==, 2);
+}
+
+Test(ScopesAreSummedPerStage)
+{
+    Profiler profiler;
+    Profiler::Time start = Profiler::Now();
+    profiler.record("geometry", start, start + std::chrono::milliseconds(2));
+    profiler.record("lighting", start, start + std::chrono::milliseconds(1));
+    profiler.record("geometry", start, start + std::chrono::milliseconds(3));
+    {
+        Profiler::Scope scope = profiler.scope("present");
+    }
+
+    std::vector<Profiler::Stage> stages = profiler.stages();
+    Check(int(stages.size()), ==, 3);
+    Check(stages[0].name,  ==, std::string("geometry"));
+    Check(stages[0].calls, ==, 2);
+    Checkf(std::abs(stages[0].total - 0.005) < 1e-9, ==, true, "Total %s", stages[0].total);
+    Check(stages[2].name,  ==, std::string("present"));
+    Check(stages[2].calls, ==, 1);
+}
+
+Test(TraceHasEventsOnlyWhenEnabled)
+{
+    Profiler profiler;
+    profiler.record("hidden", Profiler::Now(), Profiler::Now());
+
+    profiler.trace(true);
+    profiler.begin_frame();
+    {
+        Profiler::Scope scope = profiler.scope("geometry");
+    }
+    profiler.end_frame();
+
+    std::string json = profiler.trace_json();
+    Check(json.find("\"hidden\""), ==, std::string::npos);
+    for (const char* field : { "\"traceEvents\"", "\"name\": \"geometry\"", "\"name\": \"frame\"", "\"ph\": \"X\"", "\"tid\": 0" })
+        Checkf(json.find(field) != std::string::npos, ==, true, "Field %s", field);
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}
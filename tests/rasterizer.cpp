@@ -0,0 +1,287 @@
+#include "test.h"
+#include "Rasterizer.h"
+#include "glm/gtc/constants.hpp"
+
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using glm::vec2;
+using glm::vec3;
+
+
+const int WIDTH  = 64;
+const int HEIGHT = 64;
+
+ScreenVertex At(float x, float y, float z_inv = 1.0f)
+{
+    return { vec2(x, y), z_inv, vec3(x, y, 0) };
+}
+
+float RandomFloat(float low, float high)
+{
+    return low + (high - low) * (float(rand()) / float(RAND_MAX));
+}
+
+
+Test(SharedEdgesAreDrawnOnce)
+{
+    srand(1);
+    for (int i = 0; i < 200; ++i)
+    {
+        // A convex quad (its corners are on a circle, one per quadrant) at subpixel positions.
+        vec2 center = vec2(RandomFloat(16, 48), RandomFloat(16, 48));
+        float radius = RandomFloat(5, 50);
+        auto corner = [&](int quadrant) {
+            float angle = (float(quadrant) + RandomFloat(0.05f, 0.95f)) * glm::half_pi<float>();
+            vec2  point = center + radius * vec2(glm::cos(angle), glm::sin(angle));
+            return At(point.x, point.y);
+        };
+        ScreenVertex a = corner(0);
+        ScreenVertex b = corner(1);
+        ScreenVertex c = corner(2);
+        ScreenVertex d = corner(3);
+
+        std::vector<int> quad(WIDTH * HEIGHT, 0);
+        std::vector<int> split(WIDTH * HEIGHT, 0);
+        auto count = [](std::vector<int>& counts) {
+            return [&counts](const Pixel& pixel) { counts[pixel.y * WIDTH + pixel.x] += 1; };
+        };
+
+        RasterizeTriangle(a, b, c, 0, 0, WIDTH, HEIGHT, count(split));
+        RasterizeTriangle(a, d, c, 0, 0, WIDTH, HEIGHT, count(split));  // Opposite winding.
+
+        // The same quad split along the other diagonal must cover the same pixels.
+        RasterizeTriangle(a, b, d, 0, 0, WIDTH, HEIGHT, count(quad));
+        RasterizeTriangle(b, c, d, 0, 0, WIDTH, HEIGHT, count(quad));
+
+        for (int p = 0; p < WIDTH * HEIGHT; ++p)
+        {
+            Checkf(split[p], <=, 1, "Quad %s", i);
+            Checkf(split[p], ==, quad[p], "Quad %s", i);
+        }
+    }
+}
+
+Test(CoversPixelsInsideAndClipsToRectangle)
+{
+    // Right triangle with its corner at (8, 8) and legs of 16 pixels.
+    std::vector<int> counts(WIDTH * HEIGHT, 0);
+    RasterizeTriangle(At(8, 8), At(24, 8), At(8, 24), 0, 0, WIDTH, HEIGHT, [&](const Pixel& pixel) {
+        counts[pixel.y * WIDTH + pixel.x] += 1;
+    });
+
+    Check(counts[8  * WIDTH + 8],  ==, 1);  // Top-left corner is on a top and a left edge.
+    Check(counts[12 * WIDTH + 12], ==, 1);
+    Check(counts[8  * WIDTH + 24], ==, 0);  // Only on the hypotenuse, which is a right edge.
+    Check(counts[20 * WIDTH + 20], ==, 0);
+
+    int clipped = 0;
+    RasterizeTriangle(At(-100, -100), At(300, -100), At(-100, 300), 10, 20, 30, 40, [&](const Pixel& pixel) {
+        Check(pixel.x >= 10 && pixel.x < 30 && pixel.y >= 20 && pixel.y < 40, ==, true);
+        clipped += 1;
+    });
+    Check(clipped, ==, 20 * 20);
+}
+
+Test(InterpolatesBarycentrics)
+{
+    ScreenVertex a = { vec2(0, 0),  1.0f, vec3(1, 0, 0) };
+    ScreenVertex b = { vec2(60, 0), 2.0f, vec3(0, 1, 0) };
+    ScreenVertex c = { vec2(0, 60), 3.0f, vec3(0, 0, 1) };
+
+    RasterizeTriangle(a, b, c, 0, 0, WIDTH, HEIGHT, [&](const Pixel& pixel) {
+        // z_inv is linear on the screen, and the position weights are the barycentrics.
+        float expected = 1.0f + float(pixel.x) / 60.0f + 2.0f * float(pixel.y) / 60.0f;
+        Checkf(glm::abs(pixel.z_inv - expected), <, 1e-4f, "Pixel %s", pixel.x);
+        Checkf(glm::abs(pixel.position.x + pixel.position.y + pixel.position.z - 1.0f), <, 1e-5f, "Pixel %s", pixel.x);
+    });
+}
+
+Test(DegenerateTrianglesCoverNothing)
+{
+    int covered = 0;
+    RasterizeTriangle(At(0, 0), At(10, 10), At(20, 20), 0, 0, WIDTH, HEIGHT, [&](const Pixel&) { covered += 1; });
+    RasterizeTriangle(At(5, 5), At(5, 5),   At(30, 2),  0, 0, WIDTH, HEIGHT, [&](const Pixel&) { covered += 1; });
+    Check(covered, ==, 0);
+}
+
+Test(BinnedTilesMatchWholeScreen)
+{
+    srand(2);
+    const int width  = 200;
+    const int height = 150;
+
+    std::vector<ScreenVertex> vertices;
+    for (int i = 0; i < 3 * 100; ++i)
+        vertices.push_back(At(RandomFloat(-20, width + 20), RandomFloat(-20, height + 20), RandomFloat(0.1f, 1.0f)));
+
+    // The last triangle drawn to a pixel wins, so this also checks that the bins keep the order.
+    std::vector<int> expected(width * height, -1);
+    for (int i = 0; i < 100; ++i)
+        RasterizeTriangle(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], 0, 0, width, height, [&](const Pixel& pixel) {
+            expected[pixel.y * width + pixel.x] = i;
+        });
+
+    TileBinner binner(32);
+    for (int frame = 0; frame < 2; ++frame)  // The second frame reuses the bins.
+    {
+        binner.begin_frame(width, height);
+        for (int i = 0; i < 100; ++i)
+            binner.add(i, vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+
+        std::vector<int> actual(width * height, -1);
+        for (int tile = 0; tile < binner.tile_count(); ++tile)
+        {
+            int x_min, y_min, x_max, y_max;
+            binner.bounds(tile, x_min, y_min, x_max, y_max);
+            for (int i : binner.triangles(tile))
+                RasterizeTriangle(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], x_min, y_min, x_max, y_max, [&](const Pixel& pixel) {
+                    Check(actual[pixel.y * width + pixel.x] < i, ==, true);
+                    actual[pixel.y * width + pixel.x] = i;
+                });
+        }
+
+        for (int p = 0; p < width * height; ++p)
+            Checkf(actual[p], ==, expected[p], "Pixel %s", p);
+    }
+}
+
+Test(HugeTrianglesAreBinnedToEveryTile)
+{
+    const float huge = 1e12f;
+    const float inf  = std::numeric_limits<float>::infinity();
+
+    TileBinner binner(32);
+    binner.begin_frame(200, 150);
+    binner.add(0, At(-huge, -huge), At(huge, -huge), At(0, huge));
+    binner.add(1, At(-inf, -inf), At(inf, -inf), At(0, inf));
+
+    // NOTE: Both cover the whole screen, so they must be in every bin, in order.
+    for (int tile = 0; tile < binner.tile_count(); ++tile)
+        Checkf(binner.triangles(tile) == std::vector<int>({ 0, 1 }), ==, true, "Tile %s", tile);
+}
+
+Test(HierarchicalDepthMatchesDepthTest)
+{
+    srand(3);
+    std::vector<ScreenVertex> vertices;
+    for (int i = 0; i < 3 * 200; ++i)
+        vertices.push_back(At(RandomFloat(-10, WIDTH + 10), RandomFloat(-10, HEIGHT + 10), RandomFloat(0.1f, 1.0f)));
+
+    std::vector<float> expected(WIDTH * HEIGHT, 0.0f);
+    std::vector<int>   expected_shaded(WIDTH * HEIGHT, 0);
+    for (int i = 0; i < 200; ++i)
+        RasterizeTriangle(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], 0, 0, WIDTH, HEIGHT, [&](const Pixel& pixel) {
+            float& depth = expected[pixel.y * WIDTH + pixel.x];
+            if (depth < pixel.z_inv)
+            {
+                depth = pixel.z_inv;
+                expected_shaded[pixel.y * WIDTH + pixel.x] += 1;
+            }
+        });
+
+    HierarchicalDepth depth;
+    depth.resize(0, 0, WIDTH, HEIGHT);
+    depth.clear();
+
+    std::vector<int> shaded(WIDTH * HEIGHT, 0);
+    for (int i = 0; i < 200; ++i)
+        RasterizeTriangle(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], depth, [&](const Pixel& pixel) {
+            shaded[pixel.y * WIDTH + pixel.x] += 1;
+        });
+
+    for (int y = 0; y < HEIGHT; ++y)
+        for (int x = 0; x < WIDTH; ++x)
+        {
+            Checkf(depth.at(x, y), ==, expected[y * WIDTH + x], "Pixel %s", x);
+            Checkf(shaded[y * WIDTH + x], ==, expected_shaded[y * WIDTH + x], "Pixel %s", x);
+        }
+
+    // A triangle behind everything drawn so far touches nothing at all.
+    RasterizeTriangle(At(0, 0), At(200, 0), At(0, 200), 0, 0, WIDTH, HEIGHT, [&](const Pixel& pixel) {
+        depth.at(pixel.x, pixel.y) = 1.0f;
+    });
+    depth.refresh(0, 0);
+
+    int covered = 0;
+    auto count = [&](const Pixel&) { covered += 1; };
+    RasterizeTriangle(At(0, 0, 0.5f), At(8, 0, 0.5f), At(0, 8, 0.5f), depth, count);
+    Check(covered, ==, 0);
+    Check(depth.farthest(0, 0), ==, 1.0f);
+}
+
+ClipVertex InFront(float x, float y, float w)
+{
+    return { vec3(x * w, y * w, w), vec3(x, y, -w) };
+}
+
+Test(ClipTriangleCullsAndPassesThrough)
+{
+    std::vector<ScreenVertex> emitted;
+    auto emit = [&](const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c) {
+        emitted.insert(emitted.end(), { a, b, c });
+    };
+
+    // On the screen: emitted whole.
+    Check(ClipTriangle(InFront(10, 10, 2), InFront(50, 10, 3), InFront(10, 50, 4), WIDTH, HEIGHT, emit), ==, 1);
+    Check(glm::abs(emitted[1].screen.x - 50.0f), <, 1e-4f);
+    Check(glm::abs(emitted[2].z_inv - 0.25f), <, 1e-6f);
+
+    // Sticking out of the screen, but inside the guard band: also emitted whole.
+    Check(ClipTriangle(InFront(-500, 10, 1), InFront(500, 10, 1), InFront(10, 900, 1), WIDTH, HEIGHT, emit), ==, 1);
+
+    // Off one side of the screen, or behind the camera: culled.
+    Check(ClipTriangle(InFront(-10, 0, 1), InFront(-20, 50, 1), InFront(-5, 60, 1), WIDTH, HEIGHT, emit), ==, 0);
+    Check(ClipTriangle(InFront(10, 10, 1), InFront(20, 10, 1), InFront(10, 20, 1), -1, HEIGHT, emit), ==, 0);
+    Check(ClipTriangle(InFront(10, 10, -1), InFront(20, 10, -2), InFront(10, 20, -1), WIDTH, HEIGHT, emit), ==, 0);
+    Check(int(emitted.size()), ==, 6);
+}
+
+Test(ClipTriangleClipsNearPlaneAndGuardBand)
+{
+    std::vector<ScreenVertex> emitted;
+    auto emit = [&](const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c) {
+        emitted.insert(emitted.end(), { a, b, c });
+    };
+
+    // One vertex behind the camera leaves a quad, two leave a triangle.
+    ClipVertex behind = { vec3(0.0f, 0.0f, -1.0f), vec3(0, 0, 1) };
+    Check(ClipTriangle(InFront(10, 10, 1), InFront(20, 10, 1), behind, WIDTH, HEIGHT, emit), ==, 2);
+    Check(ClipTriangle(InFront(10, 10, 1), behind, behind, WIDTH, HEIGHT, emit), ==, 1);
+
+    // Crossing the guard band.
+    Check(ClipTriangle(InFront(-1e6f, 10, 1), InFront(1e6f, 10, 1), InFront(10, 1e6f, 1), WIDTH, HEIGHT, emit), >=, 1);
+
+    for (const ScreenVertex& v : emitted)
+    {
+        Check(1.0f / v.z_inv, >=, NEAR_PLANE * 0.999f);
+        Check(glm::abs(v.screen.x), <=, GUARD_BAND * 1.001f);
+        Check(glm::abs(v.screen.y), <=, GUARD_BAND * 1.001f);
+    }
+
+    // The clipped pieces still cover the same pixels as the unclipped triangle.
+    std::vector<int> whole(WIDTH * HEIGHT, 0);
+    std::vector<int> pieces(WIDTH * HEIGHT, 0);
+    auto count = [](std::vector<int>& counts) {
+        return [&counts](const Pixel& pixel) { counts[pixel.y * WIDTH + pixel.x] += 1; };
+    };
+
+    RasterizeTriangle(At(-300, 5), At(300, 5), At(5, 300), 0, 0, WIDTH, HEIGHT, count(whole));
+
+    ClipVertex a = InFront(-300, 5, 1);
+    ClipVertex b = InFront(300, 5, 1);
+    ClipVertex c = InFront(5, 300, 1);
+    int clipped = ClipTriangle(a, b, c, WIDTH, HEIGHT, [&](const ScreenVertex& p, const ScreenVertex& q, const ScreenVertex& r) {
+        RasterizeTriangle(p, q, r, 0, 0, WIDTH, HEIGHT, count(pieces));
+    });
+    Check(clipped, ==, 1);
+    for (int p = 0; p < WIDTH * HEIGHT; ++p)
+        Checkf(pieces[p], ==, whole[p], "Pixel %s", p);
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,271 @@
+#include "test.h"
+#include "RayTracing.h"
+
+#include <cstdlib>
+#include <vector>
+
+using glm::vec3;
+using glm::mat3;
+
+
+float RandomFloat(float low, float high)
+{
+    return low + (high - low) * (float(rand()) / float(RAND_MAX));
+}
+
+vec3 RandomVec3(float low, float high)
+{
+    return vec3(RandomFloat(low, high), RandomFloat(low, high), RandomFloat(low, high));
+}
+
+/// A soup of small random triangles inside [-1, 1]^3.
+std::vector<Triangle> RandomTriangles(int count)
+{
+    std::vector<Triangle> triangles;
+    triangles.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        vec3 center = RandomVec3(-1.0f, 1.0f);
+        triangles.emplace_back(center + RandomVec3(-0.1f, 0.1f), center + RandomVec3(-0.1f, 0.1f), center + RandomVec3(-0.1f, 0.1f), vec3(1));
+    }
+    return triangles;
+}
+
+/// The original per-ray solve of `A * (t, u, v) = origin - v0`, used as reference for `IntersectTriangle`.
+float IntersectTriangleByInverse(const Triangle& triangle, vec3 origin, vec3 direction)
+{
+    mat3 A(-direction, triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+    vec3 x = glm::inverse(A) * (origin - triangle.v0);
+    if (x[0] >= 0 && x[1] >= 0 && x[2] >= 0 && x[1] + x[2] <= 1)
+        return x[0];
+    return INFINITE_DISTANCE;
+}
+
+float BruteForceClosest(const std::vector<TriangleRecord>& records, vec3 origin, vec3 direction)
+{
+    float closest = INFINITE_DISTANCE;
+    for (const TriangleRecord& record : records)
+        closest = glm::min(closest, IntersectTriangle(record, origin, direction));
+    return closest;
+}
+
+float BVHClosest(const std::vector<TriangleRecord>& records, const BVH& bvh, vec3 origin, vec3 direction)
+{
+    float closest = INFINITE_DISTANCE;
+    bvh.traverse(origin, direction, closest, [&](int i, float& t_max) {
+        t_max = glm::min(t_max, IntersectTriangle(records[i], origin, direction));
+    });
+    return closest;
+}
+
+
+Test(BVHReferencesEveryTriangleOnce)
+{
+    srand(1);
+    std::vector<Triangle> triangles = RandomTriangles(2000);
+    BVH bvh = BVH::Build(triangles);
+
+    std::vector<int> references(triangles.size(), 0);
+    for (const BVHNode& node : bvh.nodes)
+        for (int i = node.first; node.is_leaf() && i < node.first + node.count; ++i)
+            references[bvh.indices[i]] += 1;
+
+    for (int count : references)
+        Check(count, ==, 1);
+
+    Check(bvh.nodes.size(), <=, 2 * triangles.size() - 1);
+}
+
+Test(BVHLeavesAreContainedInParents)
+{
+    srand(2);
+    std::vector<Triangle> triangles = RandomTriangles(2000);
+    BVH bvh = BVH::Build(triangles);
+
+    for (const BVHNode& node : bvh.nodes)
+    {
+        if (node.is_leaf())
+            continue;
+
+        for (int child = node.first; child <= node.first + 1; ++child)
+        {
+            Check(glm::all(glm::lessThanEqual(node.bounds.min, bvh.nodes[child].bounds.min)), ==, true);
+            Check(glm::all(glm::greaterThanEqual(node.bounds.max, bvh.nodes[child].bounds.max)), ==, true);
+        }
+    }
+}
+
+Test(IntersectTriangleMatchesMatrixInverse)
+{
+    srand(5);
+    std::vector<Triangle> triangles = RandomTriangles(1000);
+    std::vector<TriangleRecord> records = BuildTriangleRecords(triangles);
+
+    for (int i = 0; i < int(triangles.size()); ++i)
+    {
+        const Triangle& triangle = triangles[i];
+        vec3 origin = RandomVec3(-2.0f, 2.0f);
+
+        // Aim well inside the triangle, and well outside of it, so rounding can't decide the outcome.
+        float u = RandomFloat(0.1f, 0.4f);
+        float v = RandomFloat(0.1f, 0.4f);
+        vec3 inside  = triangle.v0 + u * (triangle.v1 - triangle.v0) + v * (triangle.v2 - triangle.v0);
+        vec3 outside = triangle.v0 - u * (triangle.v1 - triangle.v0) - v * (triangle.v2 - triangle.v0);
+
+        float expected = IntersectTriangleByInverse(triangle, origin, inside - origin);
+        float actual   = IntersectTriangle(records[i], origin, inside - origin);
+        Checkf(glm::abs(actual - expected), <, 1e-4f, "Triangle %s", i);
+
+        Check(IntersectTriangle(records[i], origin, outside - origin), ==, INFINITE_DISTANCE);
+        Check(IntersectTriangle(records[i], origin, origin - inside), ==, INFINITE_DISTANCE);
+    }
+}
+
+Test(BVHClosestMatchesBruteForce)
+{
+    srand(3);
+    std::vector<Triangle> triangles = RandomTriangles(3000);
+    std::vector<TriangleRecord> records = BuildTriangleRecords(triangles);
+    BVH bvh = BVH::Build(triangles);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        vec3 origin    = RandomVec3(-2.0f, 2.0f);
+        vec3 direction = RandomVec3(-1.0f, 1.0f);
+
+        float expected = BruteForceClosest(records, origin, direction);
+        float actual   = BVHClosest(records, bvh, origin, direction);
+        Checkf(actual, ==, expected, "Ray %s", i);
+    }
+}
+
+Test(BVHClosestMatchesBruteForceInCornellBox)
+{
+    srand(4);
+    std::vector<Triangle> triangles = LoadTestModel();
+    std::vector<TriangleRecord> records = BuildTriangleRecords(triangles);
+    BVH bvh = BVH::Build(triangles);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        vec3 origin    = RandomVec3(-0.9f, 0.9f);
+        vec3 direction = RandomVec3(-1.0f, 1.0f);
+
+        float expected = BruteForceClosest(records, origin, direction);
+        float actual   = BVHClosest(records, bvh, origin, direction);
+        Checkf(actual, ==, expected, "Ray %s", i);
+    }
+}
+
+Test(OccludedMatchesBruteForce)
+{
+    srand(6);
+    Scene scene = Scene::Create(RandomTriangles(3000));
+
+    int occluded = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        vec3  origin    = RandomVec3(-1.5f, 1.5f);
+        vec3  direction = glm::normalize(RandomVec3(-1.0f, 1.0f));
+        float t_max     = RandomFloat(0.0f, 2.0f);
+
+        bool expected = BruteForceClosest(scene.records(), origin, direction) < t_max;
+        bool actual   = Occluded(scene, origin, direction, t_max);
+        Checkf(actual, ==, expected, "Ray %s", i);
+
+        occluded += actual;
+    }
+
+    // Make sure both outcomes are actually exercised.
+    Check(occluded, >, 100);
+    Check(occluded, <, 900);
+}
+
+Test(KernelsMatchScalarKernel)
+{
+    srand(7);
+    std::vector<Triangle> triangles = RandomTriangles(3000);
+    const Scene reference = Scene::Create(triangles, Kernel::SCALAR);
+
+    for (Kernel kernel : { Kernel::SSE, Kernel::AVX2 })
+    {
+        if (SupportedKernel(kernel) != kernel)
+            continue;
+
+        const Scene scene = Scene::Create(triangles, kernel);
+        for (int i = 0; i < 1000; ++i)
+        {
+            vec3  origin    = RandomVec3(-1.5f, 1.5f);
+            vec3  direction = RandomVec3(-1.0f, 1.0f);
+            float t_max     = RandomFloat(0.0f, 2.0f);
+
+            Intersection expected = { vec3(0), -1.0f, -1 };
+            Intersection actual   = { vec3(0), -1.0f, -1 };
+            ClosestIntersection(reference, origin, direction, expected);
+            ClosestIntersection(scene,     origin, direction, actual);
+
+            Checkf(actual.triangle_index, ==, expected.triangle_index, "Ray %s", i);
+            Checkf(actual.distance,       ==, expected.distance,       "Ray %s", i);
+            Checkf(Occluded(scene, origin, direction, t_max), ==, Occluded(reference, origin, direction, t_max), "Ray %s", i);
+        }
+    }
+}
+
+Test(ClosestIntersectionMatchesBruteForce)
+{
+    srand(8);
+    const Scene scene = Scene::Create(RandomTriangles(3000));
+
+    for (int i = 0; i < 500; ++i)
+    {
+        vec3 origin    = RandomVec3(-1.5f, 1.5f);
+        vec3 direction = RandomVec3(-1.0f, 1.0f);
+
+        Intersection intersection = { vec3(0), INFINITE_DISTANCE, -1 };
+        ClosestIntersection(scene, origin, direction, intersection);
+
+        Checkf(intersection.distance, ==, BruteForceClosest(scene.records(), origin, direction), "Ray %s", i);
+    }
+}
+
+Test(PacketMatchesSingleRays)
+{
+    srand(9);
+    std::vector<Triangle> triangles = RandomTriangles(3000);
+
+    for (Kernel kernel : { Kernel::SCALAR, Kernel::SSE })
+    {
+        const Scene scene = Scene::Create(triangles, kernel);
+        for (int i = 0; i < 500; ++i)
+        {
+            // Coherent rays from one origin, with a random subset of the lanes active.
+            vec3 origin = RandomVec3(-1.5f, 1.5f);
+            vec3 center = RandomVec3(-1.0f, 1.0f);
+            int  active = 1 + rand() % 15;
+
+            RayPacket packet;
+            for (int lane = 0; lane < RayPacket::LANES; ++lane)
+                if (active & (1 << lane))
+                    packet.set(lane, origin, center + RandomVec3(-0.05f, 0.05f));
+
+            Intersection actual[RayPacket::LANES];
+            ClosestIntersection(scene, packet, actual);
+
+            for (int lane = 0; lane < RayPacket::LANES; ++lane)
+            {
+                Intersection expected = { vec3(0), INFINITE_DISTANCE, -1 };
+                if (packet.is_active(lane))
+                    ClosestIntersection(scene, packet.lane_origin(lane), packet.lane_direction(lane), expected);
+
+                Checkf(actual[lane].triangle_index, ==, expected.triangle_index, "Ray %s", i);
+                Checkf(actual[lane].distance,       ==, expected.distance,       "Ray %s", i);
+            }
+        }
+    }
+}
+
+
+int main()
+{
+    RunAllTests();
+}
@@ -0,0 +1,89 @@
+#include "test.h"
+#include "StarField.h"
+
+#include <cstdlib>
+#include <vector>
+
+using glm::vec3;
+
+
+float RandomFloat(float low, float high)
+{
+    return low + (high - low) * (float(rand()) / float(RAND_MAX));
+}
+
+/// Stars like Lab1's, with a count that leaves a tail for the scalar code in every kernel.
+StarField RandomStars(int count)
+{
+    StarField stars;
+    for (int i = 0; i < count; ++i)
+        stars.add(vec3(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(0.001f, 1.0f)));
+    return stars;
+}
+
+Test(UpdateWrapsAround)
+{
+    srand(3);
+    StarField stars = RandomStars(1003);
+
+    for (Kernel kernel : { Kernel::SCALAR, Kernel::SSE, Kernel::AVX2 })
+    {
+        if (SupportedKernel(kernel) != kernel)
+            continue;
+
+        for (float dt : { 0.3f, -0.45f, 0.05f })
+        {
+            stars.update(0, stars.size(), vec3(0.1f, -0.2f, 1.0f), dt, kernel);
+            for (int i = 0; i < stars.size(); ++i)
+                Checkf(0.0f < stars.position(i).z && stars.position(i).z <= 1.0f, ==, true, "Star %s", i);
+        }
+    }
+}
+
+Test(KernelsMatchScalarKernel)
+{
+    srand(5);
+    const StarField initial = RandomStars(5003);
+
+    const int width = 64, height = 48, stride = 70;
+    StarField expected = initial;
+    std::vector<uint32_t> expected_pixels(size_t(stride) * height, 0);
+    expected.update(0, expected.size(), vec3(0, 0, 1), 0.4f, Kernel::SCALAR);
+    expected.draw(0, expected.size(), expected_pixels.data(), width, height, stride, height / 2.0f, Kernel::SCALAR);
+
+    for (Kernel kernel : { Kernel::SSE, Kernel::AVX2 })
+    {
+        if (SupportedKernel(kernel) != kernel)
+            continue;
+
+        // NOTE: Odd ranges, so each kernel starts and ends between its groups of lanes.
+        StarField actual = initial;
+        std::vector<uint32_t> actual_pixels(size_t(stride) * height, 0);
+        for (int begin : { 0, 1001, 3002 })
+        {
+            int end = begin == 3002 ? actual.size() : begin == 0 ? 1001 : 3002;
+            actual.update(begin, end, vec3(0, 0, 1), 0.4f, kernel);
+            actual.draw(begin, end, actual_pixels.data(), width, height, stride, height / 2.0f, kernel);
+        }
+
+        for (int i = 0; i < actual.size(); ++i)
+            Checkf(actual.position(i) == expected.position(i), ==, true, "Star %s", i);
+        for (size_t i = 0; i < actual_pixels.size(); ++i)
+            Checkf(actual_pixels[i], ==, expected_pixels[i], "Pixel %s", int(i));
+    }
+}
+
+Test(ColorFadesWithDistance)
+{
+    Check(StarField::Color(1.0f), ==, 0xFFFFFFFFu);
+    Check(StarField::Color(5.0f), ==, 0xFFFFFFFFu);
+    Check(StarField::Color(0.2f), ==, 0xFF333333u);
+    Check(StarField::Color(-1.0f), ==, 0xFF000000u);
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}
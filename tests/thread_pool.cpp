@@ -0,0 +1,79 @@
+#include "test.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+
+Test(ParallelForVisitsEveryIndexOnce)
+{
+    for (int threads : { 1, 2, 3, 8 })
+    {
+        ThreadPool pool(threads);
+        for (int count : { 0, 1, 7, 64, 1000 })
+        {
+            std::vector<std::atomic<int>> visits(count);
+            pool.parallel_for(count, [&](int i) { visits[i].fetch_add(1); });
+
+            for (int i = 0; i < count; ++i)
+                Checkf(visits[i].load(), ==, 1, "Index %s", i);
+        }
+    }
+}
+
+Test(ParallelForCanBeReused)
+{
+    ThreadPool pool(4);
+
+    std::atomic<long long> sum { 0 };
+    for (int round = 0; round < 200; ++round)
+        pool.parallel_for(100, [&](int i) { sum.fetch_add(i); });
+
+    Check(sum.load(), ==, 200LL * (99 * 100 / 2));
+}
+
+Test(ParallelForBalancesUnevenWork)
+{
+    ThreadPool pool(4);
+
+    // All the work is in the first share; the other threads have to steal it.
+    std::atomic<int> done { 0 };
+    pool.parallel_for(64, [&](int i) {
+        if (i < 16)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        done.fetch_add(1);
+    });
+
+    Check(done.load(), ==, 64);
+}
+
+Test(TilesCoverFrameExactlyOnce)
+{
+    const int width  = 103;
+    const int height = 61;
+
+    for (int tile_size : { 1, 8, 16, 64, 200 })
+    {
+        TileScheduler scheduler(4, tile_size);
+
+        std::vector<std::atomic<int>> coverage(width * height);
+        scheduler.for_each_tile(width, height, [&](int x_min, int y_min, int x_max, int y_max) {
+            for (int y = y_min; y < y_max; ++y)
+                for (int x = x_min; x < x_max; ++x)
+                    coverage[y * width + x].fetch_add(1);
+        });
+
+        int wrong = 0;
+        for (auto& count : coverage)
+            wrong += count.load() != 1;
+        Checkf(wrong, ==, 0, "Tile size %s", tile_size);
+    }
+}
+
+
+
+int main()
+{
+    RunAllTests();
+}